@@ -0,0 +1,123 @@
+#include <cstring>
+
+#include "animationstreamer.h"
+#include "tileencoder.h"
+
+namespace chrbrew
+{
+    AnimationStreamer::AnimationStreamer(int budget, int duration)
+        : budget(budget), duration(duration)
+    {
+    }
+
+    void AnimationStreamer::addSheet(const QImage& image, const QList<int>& conversions, int frameHeight)
+    {
+        int height = frameHeight > 0 ? frameHeight : image.height();
+        for(int y = 0; y + height <= image.height(); y += height)
+        {
+            Frame frame;
+            frame.image = image.copy(0, y, image.width(), height);
+            frame.lookup = TileEncoder::lookup(conversions);
+            frames.append(frame);
+        }
+    }
+
+    QByteArray AnimationStreamer::encodeFrame(const Frame& frame)
+    {
+        return TileEncoder::encodeImage(frame.image, frame.lookup, TileEncoder::HEIGHT);
+    }
+
+    AnimationStreamer::Result AnimationStreamer::stream() const
+    {
+        Result result;
+        result.valid = false;
+        result.tiles = 0;
+        result.vblanks = 0;
+        result.worstFrame = 0;
+        result.worstFrameBytes = 0;
+        result.peakVblankBytes = 0;
+        result.maxDelay = 0;
+        result.leftoverBytes = 0;
+
+        int tilesPerVblank = qMin(budget / TileEncoder::BYTES, int(MAX_VBLANK_TILES));
+        if(frames.isEmpty())
+        {
+            result.error = QObject::tr("There are no frames to animate.");
+            return result;
+        }
+        if(tilesPerVblank == 0)
+        {
+            result.error = QObject::tr("The budget must allow at least one tile (%1 bytes) per vblank.").arg(TileEncoder::BYTES);
+            return result;
+        }
+        foreach(const Frame& frame, frames)
+        {
+            if(frame.image.size() != frames[0].image.size())
+            {
+                result.error = QObject::tr("Every frame must be the same size.");
+                return result;
+            }
+        }
+
+        auto data = QtConcurrent::blockingMapped<QList<QByteArray> >(frames, &AnimationStreamer::encodeFrame);
+        result.tiles = data[0].size() / TileEncoder::BYTES;
+        if(result.tiles > MAX_TILES)
+        {
+            result.error = QObject::tr("Frames have %1 tiles, but only %2 can be indexed.").arg(result.tiles).arg(MAX_TILES);
+            return result;
+        }
+        result.initial = data[0];
+
+        // Queued tiles wait in first-changed order. A tile that changes again before it is sent
+        // keeps its place but sends the newer data, so nothing is uploaded twice.
+        QList<int> queue;
+        QHash<int, int> pendingFrame;
+        QHash<int, int> queuedAt;
+        int count = frames.count();
+        result.frameBytes.fill(0, count);
+        for(int f = 0; f != count; ++f)
+        {
+            // The animation loops, so the first frame is compared against the last.
+            const auto& previous = data[(f + count - 1) % count];
+            const auto& current = data[f];
+            for(int t = 0; t != result.tiles; ++t)
+            {
+                int offset = t * TileEncoder::BYTES;
+                if(std::memcmp(previous.constData() + offset, current.constData() + offset, TileEncoder::BYTES) != 0)
+                {
+                    // The delay counts from the first change still waiting, not the latest one.
+                    if(!pendingFrame.contains(t))
+                    {
+                        queue.append(t);
+                        queuedAt[t] = result.vblanks;
+                    }
+                    pendingFrame[t] = f;
+                    result.frameBytes[f] += TileEncoder::BYTES;
+                }
+            }
+            if(result.frameBytes[f] > result.worstFrameBytes)
+            {
+                result.worstFrame = f;
+                result.worstFrameBytes = result.frameBytes[f];
+            }
+
+            for(int v = 0; v != duration; ++v, ++result.vblanks)
+            {
+                int sent = qMin(tilesPerVblank, queue.count());
+                result.stream.append(char(sent));
+                for(int i = 0; i != sent; ++i)
+                {
+                    int t = queue.takeFirst();
+                    result.stream.append(char(t));
+                    result.stream.append(data[pendingFrame.take(t)].constData() + t * TileEncoder::BYTES, TileEncoder::BYTES);
+                    result.maxDelay = qMax(result.maxDelay, result.vblanks - queuedAt.take(t));
+                }
+                result.peakVblankBytes = qMax(result.peakVblankBytes, sent * TileEncoder::BYTES);
+            }
+        }
+        result.leftoverBytes = queue.count() * TileEncoder::BYTES;
+
+        result.valid = true;
+        return result;
+    }
+}
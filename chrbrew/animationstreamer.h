@@ -0,0 +1,61 @@
+#ifndef ANIMATIONSTREAMER_H
+#define ANIMATIONSTREAMER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Turns a looping tile animation into a stream of CHR-RAM updates that never exceeds a per-vblank byte budget.
+    class AnimationStreamer
+    {
+        public:
+            static const int MAX_TILES = 256;
+            // Each vblank's tile count is one byte.
+            static const int MAX_VBLANK_TILES = 255;
+
+            struct Result
+            {
+                bool valid;
+                QString error;
+
+                // Every tile of the first frame, to load before the animation starts.
+                QByteArray initial;
+
+                // One packet per vblank: a tile count, then a tile index and 16 bytes of tile data per tile.
+                QByteArray stream;
+
+                QVector<int> frameBytes;
+                int tiles;
+                int vblanks;
+                int worstFrame;
+                int worstFrameBytes;
+                int peakVblankBytes;
+                int maxDelay;
+                int leftoverBytes;
+            };
+
+            // The budget counts tile data bytes per vblank; each frame is shown for the given number of vblanks.
+            AnimationStreamer(int budget, int duration);
+
+            // Splits an image into frames of frameHeight rows (or takes it whole, when frameHeight is 0).
+            // Conversions map each image color to a 2-bit color index.
+            void addSheet(const QImage& image, const QList<int>& conversions, int frameHeight);
+
+            Result stream() const;
+
+        private:
+            struct Frame
+            {
+                QImage image;
+                QVector<uchar> lookup;
+            };
+
+            static QByteArray encodeFrame(const Frame& frame);
+
+            int budget;
+            int duration;
+            QList<Frame> frames;
+    };
+}
+
+#endif
@@ -1,5 +1,33 @@
+QT += network
+
 SOURCES += main.cpp \
     mainwindow.cpp \
-    editorwidget.cpp
+    editorwidget.cpp \
+    animationstreamer.cpp \
+    codec.cpp \
+    conversionserver.cpp \
+    converter.cpp \
+    cpu6502.cpp \
+    ditherer.cpp \
+    mapimporter.cpp \
+    metatilebuilder.cpp \
+    rompatcher.cpp \
+    screenconverter.cpp \
+    tileencoder.cpp \
+    tilereducer.cpp
 HEADERS += mainwindow.h \
-    editorwidget.h
+    editorwidget.h \
+    animationstreamer.h \
+    codec.h \
+    conversionserver.h \
+    converter.h \
+    cpu6502.h \
+    ditherer.h \
+    mapimporter.h \
+    metatilebuilder.h \
+    rompatcher.h \
+    screenconverter.h \
+    tileencoder.h \
+    tilereducer.h
+
+include(../common/common.pri)
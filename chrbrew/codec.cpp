@@ -0,0 +1,280 @@
+#include "codec.h"
+#include "atomicfile.h"
+#include "cpu6502.h"
+
+namespace chrbrew
+{
+    namespace
+    {
+        const int ROUTINE_ADDRESS = 0xF000;
+        const int DATA_ADDRESS = 0x8000;
+        const qint64 CYCLE_LIMIT = 100000000;
+
+        // Inputs: ($00) = source, $02 = remaining bytes, $03 = whole pages.
+        const unsigned char copyRoutine[] = {
+            0xA0, 0x00,              // F000         LDY #$00
+            0xA6, 0x03,              // F002         LDX $03
+            0xF0, 0x0D,              // F004         BEQ tail
+            0xB1, 0x00,              // F006 page:   LDA ($00),Y
+            0x8D, 0x07, 0x20,        // F008         STA $2007
+            0xC8,                    // F00B         INY
+            0xD0, 0xF8,              // F00C         BNE page
+            0xE6, 0x01,              // F00E         INC $01
+            0xCA,                    // F010         DEX
+            0xD0, 0xF3,              // F011         BNE page
+            0xA5, 0x02,              // F013 tail:   LDA $02
+            0xF0, 0x0A,              // F015         BEQ done
+            0xB1, 0x00,              // F017 byte:   LDA ($00),Y
+            0x8D, 0x07, 0x20,        // F019         STA $2007
+            0xC8,                    // F01C         INY
+            0xC4, 0x02,              // F01D         CPY $02
+            0xD0, 0xF6,              // F01F         BNE byte
+            0x60,                    // F021 done:   RTS
+        };
+
+        // Inputs: ($00) = source. $02 holds the tag and $03 the previous byte.
+        const unsigned char rleRoutine[] = {
+            0xA0, 0x00,              // F000         LDY #$00
+            0x20, 0x28, 0xF0,        // F002         JSR get
+            0x85, 0x02,              // F005         STA $02
+            0x20, 0x28, 0xF0,        // F007 loop:   JSR get
+            0xC5, 0x02,              // F00A         CMP $02
+            0xF0, 0x08,              // F00C         BEQ run
+            0x8D, 0x07, 0x20,        // F00E         STA $2007
+            0x85, 0x03,              // F011         STA $03
+            0x4C, 0x07, 0xF0,        // F013         JMP loop
+            0x20, 0x28, 0xF0,        // F016 run:    JSR get
+            0xAA,                    // F019         TAX
+            0xF0, 0x0B,              // F01A         BEQ done
+            0xA5, 0x03,              // F01C         LDA $03
+            0x8D, 0x07, 0x20,        // F01E rep:    STA $2007
+            0xCA,                    // F021         DEX
+            0xD0, 0xFA,              // F022         BNE rep
+            0x4C, 0x07, 0xF0,        // F024         JMP loop
+            0x60,                    // F027 done:   RTS
+            0xB1, 0x00,              // F028 get:    LDA ($00),Y
+            0xE6, 0x00,              // F02A         INC $00
+            0xD0, 0x02,              // F02C         BNE next
+            0xE6, 0x01,              // F02E         INC $01
+            0x60,                    // F030 next:   RTS
+        };
+
+        // Inputs: ($00) = source.
+        const unsigned char runsRoutine[] = {
+            0xA0, 0x00,              // F000         LDY #$00
+            0x20, 0x24, 0xF0,        // F002 loop:   JSR get
+            0xAA,                    // F005         TAX
+            0xF0, 0x1B,              // F006         BEQ done
+            0x30, 0x0B,              // F008         BMI run
+            0x20, 0x24, 0xF0,        // F00A lit:    JSR get
+            0x8D, 0x07, 0x20,        // F00D         STA $2007
+            0xCA,                    // F010         DEX
+            0xD0, 0xF7,              // F011         BNE lit
+            0xF0, 0xED,              // F013         BEQ loop
+            0x29, 0x7F,              // F015 run:    AND #$7F
+            0xAA,                    // F017         TAX
+            0x20, 0x24, 0xF0,        // F018         JSR get
+            0x8D, 0x07, 0x20,        // F01B rep:    STA $2007
+            0xCA,                    // F01E         DEX
+            0xD0, 0xFA,              // F01F         BNE rep
+            0xF0, 0xDF,              // F021         BEQ loop
+            0x60,                    // F023 done:   RTS
+            0xB1, 0x00,              // F024 get:    LDA ($00),Y
+            0xE6, 0x00,              // F026         INC $00
+            0xD0, 0x02,              // F028         BNE next
+            0xE6, 0x01,              // F02A         INC $01
+            0x60,                    // F02C next:   RTS
+        };
+
+        QByteArray routine(Codec::Type type)
+        {
+            switch(type)
+            {
+                case Codec::RLE: return QByteArray(reinterpret_cast<const char*>(rleRoutine), sizeof(rleRoutine));
+                case Codec::Runs: return QByteArray(reinterpret_cast<const char*>(runsRoutine), sizeof(runsRoutine));
+                default: return QByteArray(reinterpret_cast<const char*>(copyRoutine), sizeof(copyRoutine));
+            }
+        }
+
+        struct ArraySink
+        {
+            QByteArray* bytes;
+
+            void put(char c) { bytes->append(c); }
+            void put(const QByteArray& data) { bytes->append(data); }
+        };
+
+        struct FileSink
+        {
+            overbrew::AtomicFile* file;
+
+            void put(char c) { file->putChar(c); }
+            void put(const QByteArray& data) { file->write(data); }
+        };
+
+        template<typename Sink> void compressRuns(const QByteArray& data, Sink sink)
+        {
+            const int MAX_COUNT = 0x7F;
+            for(int i = 0, end = data.size(); i != end;)
+            {
+                int run = 1;
+                while(i + run != end && run != MAX_COUNT && data[i + run] == data[i])
+                {
+                    ++run;
+                }
+                if(run >= 3)
+                {
+                    sink.put(char(0x80 | run));
+                    sink.put(data[i]);
+                    i += run;
+                    continue;
+                }
+
+                // Literals go up to the next run worth packing.
+                int start = i;
+                while(i != end && i - start != MAX_COUNT && !(i + 2 < end && data[i] == data[i + 1] && data[i] == data[i + 2]))
+                {
+                    ++i;
+                }
+                sink.put(char(i - start));
+                sink.put(data.mid(start, i - start));
+            }
+            sink.put('\0');
+        }
+
+        // Returns false when the data uses every byte value, leaving no tag for RLE.
+        template<typename Sink> bool compressTo(Codec::Type type, const QByteArray& data, Sink sink)
+        {
+            if(type == Codec::Runs)
+            {
+                compressRuns(data, sink);
+                return true;
+            }
+            if(type != Codec::RLE)
+            {
+                sink.put(data);
+                return true;
+            }
+
+            // The tag is the first byte value the data never uses.
+            QVector<bool> used(256, false);
+            for(int i = 0, end = data.size(); i != end; ++i)
+            {
+                used[uchar(data[i])] = true;
+            }
+            int tag = used.indexOf(false);
+            if(tag == -1)
+            {
+                return false;
+            }
+
+            sink.put(char(tag));
+            for(int i = 0, end = data.size(); i != end;)
+            {
+                char value = data[i];
+                int run = 1;
+                while(i + run != end && data[i + run] == value)
+                {
+                    ++run;
+                }
+                i += run;
+
+                sink.put(value);
+                for(int repeat = run - 1; repeat > 0; repeat -= 255)
+                {
+                    // A lone repeat is no longer as a literal, and keeps the stream simpler to read.
+                    if(repeat == 1)
+                    {
+                        sink.put(value);
+                    }
+                    else
+                    {
+                        sink.put(char(tag));
+                        sink.put(char(qMin(repeat, 255)));
+                    }
+                }
+            }
+            sink.put(char(tag));
+            sink.put('\0');
+            return true;
+        }
+    }
+
+    QString Codec::name(Type type)
+    {
+        switch(type)
+        {
+            case None: return QObject::tr("None");
+            case RLE: return QObject::tr("RLE");
+            case Runs: return QObject::tr("Runs");
+            default: return QString();
+        }
+    }
+
+    QByteArray Codec::compress(Type type, const QByteArray& data, bool* ok)
+    {
+        QByteArray result;
+        ArraySink sink = { &result };
+        *ok = compressTo(type, data, sink);
+        return *ok ? result : QByteArray();
+    }
+
+    bool Codec::compress(Type type, const QByteArray& data, overbrew::AtomicFile* file)
+    {
+        FileSink sink = { file };
+        return compressTo(type, data, sink);
+    }
+
+    Codec::Cost Codec::measure(Type type, const QByteArray& chr)
+    {
+        Cost cost;
+        cost.valid = false;
+        cost.tiles = chr.size() / 16;
+        cost.banks = (chr.size() + BANK_BYTES - 1) / BANK_BYTES;
+        cost.cycles = 0;
+        cost.worstBankCycles = 0;
+
+        bool ok;
+        cost.size = compress(type, chr, &ok).size();
+        if(!ok)
+        {
+            cost.error = QObject::tr("The data uses every byte value, so it can't be %1 packed.").arg(name(type));
+            return cost;
+        }
+
+        for(int b = 0; b != cost.banks; ++b)
+        {
+            auto bank = chr.mid(b * BANK_BYTES, BANK_BYTES);
+            auto packed = compress(type, bank, &ok);
+            if(!ok)
+            {
+                cost.error = QObject::tr("Bank %1 uses every byte value, so it can't be %2 packed.").arg(b).arg(name(type));
+                return cost;
+            }
+
+            Cpu6502 cpu;
+            cpu.load(ROUTINE_ADDRESS, routine(type));
+            cpu.load(DATA_ADDRESS, packed);
+            cpu.poke(0x00, DATA_ADDRESS & 0xFF);
+            cpu.poke(0x01, DATA_ADDRESS >> 8);
+            cpu.poke(0x02, bank.size() & 0xFF);
+            cpu.poke(0x03, bank.size() >> 8);
+            if(!cpu.call(ROUTINE_ADDRESS, CYCLE_LIMIT))
+            {
+                cost.error = QObject::tr("%1 decoder, bank %2: %3").arg(name(type)).arg(b).arg(cpu.error());
+                return cost;
+            }
+            if(cpu.ppuData() != bank)
+            {
+                cost.error = QObject::tr("The %1 decoder's output doesn't match bank %2.").arg(name(type)).arg(b);
+                return cost;
+            }
+
+            cost.cycles += cpu.cycles();
+            cost.worstBankCycles = qMax(cost.worstBankCycles, cpu.cycles());
+        }
+
+        cost.valid = true;
+        return cost;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <QtGui>
+
+namespace overbrew
+{
+    class AtomicFile;
+}
+
+namespace chrbrew
+{
+    // The CHR output compression schemes, each with a reference 6502 decoder to time on real output.
+    class Codec
+    {
+        public:
+            enum Type
+            {
+                None,
+                RLE,
+                Runs,
+                TypeCount
+            };
+
+            // One pattern table.
+            static const int BANK_BYTES = 4096;
+
+            struct Cost
+            {
+                bool valid;
+                QString error;
+                int size;
+                int tiles;
+                int banks;
+                qint64 cycles;
+                qint64 worstBankCycles;
+            };
+
+            static QString name(Type type);
+
+            // RLE uses a tag byte that never occurs in the data, then literal bytes,
+            // with (tag, n) repeating the previous byte n more times and (tag, 0) ending the stream.
+            // Runs needs no free byte value: a count byte n of 1-127 is followed by n literal bytes,
+            // 0x80 | n by one byte repeated n times, and 0 ends the stream.
+            static QByteArray compress(Type type, const QByteArray& data, bool* ok);
+
+            // Streams the packed bytes into the file instead of building them in memory.
+            static bool compress(Type type, const QByteArray& data, overbrew::AtomicFile* file);
+
+            // Compresses each bank on its own and runs the decoder over it, checking what it writes to the PPU.
+            static Cost measure(Type type, const QByteArray& chr);
+    };
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include "conversionserver.h"
+#include "memorytracker.h"
+
+namespace chrbrew
+{
+    using overbrew::MemoryTracker;
+
+    namespace
+    {
+        const int CONNECT_TIMEOUT = 200;
+
+        // Messages are a 32-bit length followed by that many bytes of QDataStream data.
+        QByteArray frame(const QByteArray& payload)
+        {
+            QByteArray block;
+            QDataStream stream(&block, QIODevice::WriteOnly);
+            stream << quint32(payload.size());
+            block.append(payload);
+            return block;
+        }
+
+        bool readFrame(QLocalSocket* socket, QByteArray* payload)
+        {
+            if(socket->bytesAvailable() < qint64(sizeof(quint32)))
+            {
+                return false;
+            }
+            QDataStream header(socket->peek(sizeof(quint32)));
+            quint32 size;
+            header >> size;
+            if(socket->bytesAvailable() < qint64(sizeof(quint32) + size))
+            {
+                return false;
+            }
+            socket->read(sizeof(quint32));
+            *payload = socket->read(size);
+            return true;
+        }
+    }
+
+    ConversionServer::ConversionServer(qint64 cacheLimit)
+        : converter(cacheLimit)
+    {
+        connect(&server, SIGNAL(newConnection()), this, SLOT(accept()));
+    }
+
+    QString ConversionServer::socketName()
+    {
+        auto user = QString::fromLocal8Bit(qgetenv("USER"));
+        if(user.isEmpty())
+        {
+            user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+        }
+        return QString("chrbrew-%1").arg(user);
+    }
+
+    bool ConversionServer::listen(QString* error)
+    {
+        // A server that crashed can leave its socket file behind.
+        QLocalServer::removeServer(socketName());
+        if(!server.listen(socketName()))
+        {
+            *error = server.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    ConversionServer::Reply ConversionServer::execute(Converter* converter, const QStringList& arguments)
+    {
+        Reply reply;
+        reply.status = 0;
+
+        // --memory appends what this process holds, so a client can also ask a daemon with no jobs at all.
+        auto jobArguments = arguments;
+        bool memory = jobArguments.removeAll("--memory") != 0;
+        if(memory && jobArguments.isEmpty())
+        {
+            reply.report = MemoryTracker::report();
+            return reply;
+        }
+
+        QString error;
+        auto jobs = Converter::parseJobs(jobArguments, &error);
+        if(jobs.isEmpty())
+        {
+            reply.status = 2;
+            reply.report = error + "\n";
+            return reply;
+        }
+
+        auto results = converter->runAll(jobs);
+        for(int i = 0, end = jobs.count(); i != end; ++i)
+        {
+            if(results[i].valid && results[i].skipped)
+            {
+                reply.report += QObject::tr("%1: up to date\n").arg(jobs[i].output);
+            }
+            else if(results[i].valid)
+            {
+                reply.report += QObject::tr("%1 -> %2: %3 tile(s)\n").arg(jobs[i].input).arg(jobs[i].output).arg(results[i].tiles);
+            }
+            else
+            {
+                reply.report += QObject::tr("%1: %2\n").arg(jobs[i].input).arg(results[i].error);
+                reply.status = 1;
+            }
+        }
+        if(memory)
+        {
+            reply.report += MemoryTracker::report();
+        }
+        return reply;
+    }
+
+    bool ConversionServer::request(const QStringList& arguments, Reply* reply)
+    {
+        QLocalSocket socket;
+        socket.connectToServer(socketName());
+        if(!socket.waitForConnected(CONNECT_TIMEOUT))
+        {
+            return false;
+        }
+
+        // Relative paths belong to the client's directory, not the server's.
+        QStringList absolute;
+        foreach(const QString& argument, arguments)
+        {
+            bool value = !absolute.isEmpty() && (absolute.last() == "--conversions" || absolute.last() == "--fit");
+            bool file = !argument.startsWith("--") && !value;
+            absolute.append(file ? QFileInfo(argument).absoluteFilePath() : argument);
+        }
+
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_6);
+        stream << absolute;
+        socket.write(frame(payload));
+
+        QByteArray response;
+        while(!readFrame(&socket, &response))
+        {
+            if(!socket.waitForReadyRead(-1))
+            {
+                return false;
+            }
+        }
+
+        QDataStream in(response);
+        in.setVersion(QDataStream::Qt_4_6);
+        qint32 status;
+        in >> status >> reply->report;
+        reply->status = status;
+        return in.status() == QDataStream::Ok;
+    }
+
+    void ConversionServer::accept()
+    {
+        while(auto socket = server.nextPendingConnection())
+        {
+            connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+            connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        }
+    }
+
+    void ConversionServer::readRequest()
+    {
+        auto socket = qobject_cast<QLocalSocket*>(sender());
+        QByteArray payload;
+        while(socket && readFrame(socket, &payload))
+        {
+            QDataStream stream(payload);
+            stream.setVersion(QDataStream::Qt_4_6);
+            QStringList arguments;
+            stream >> arguments;
+
+            // Jobs run off the event loop, so other clients are served meanwhile.
+            auto watcher = new QFutureWatcher<Reply>(this);
+            pending.insert(watcher, socket);
+            connect(watcher, SIGNAL(finished()), this, SLOT(sendReply()));
+            watcher->setFuture(QtConcurrent::run(this, &ConversionServer::handle, arguments));
+        }
+    }
+
+    void ConversionServer::sendReply()
+    {
+        auto watcher = static_cast<QFutureWatcher<Reply>*>(sender());
+        auto socket = pending.take(watcher);
+        auto reply = watcher->result();
+        watcher->deleteLater();
+
+        if(socket)
+        {
+            QByteArray payload;
+            QDataStream stream(&payload, QIODevice::WriteOnly);
+            stream.setVersion(QDataStream::Qt_4_6);
+            stream << qint32(reply.status) << reply.report;
+            socket->write(frame(payload));
+        }
+    }
+
+    ConversionServer::Reply ConversionServer::handle(const QStringList& arguments)
+    {
+        return execute(&converter, arguments);
+    }
+}
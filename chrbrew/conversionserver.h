@@ -0,0 +1,48 @@
+#ifndef CONVERSIONSERVER_H
+#define CONVERSIONSERVER_H
+
+#include <QtGui>
+#include <QtNetwork>
+#include "converter.h"
+
+namespace chrbrew
+{
+    // Keeps a converter warm behind a local socket, so build systems pay for startup once.
+    // Each request is the command line arguments of a conversion; each reply is its exit status and report.
+    class ConversionServer : public QObject
+    {
+        Q_OBJECT
+        public:
+            struct Reply
+            {
+                int status;
+                QString report;
+            };
+
+            explicit ConversionServer(qint64 cacheLimit = Converter::DEFAULT_CACHE_LIMIT);
+
+            bool listen(QString* error);
+
+            static QString socketName();
+
+            // Runs a request in this process.
+            static Reply execute(Converter* converter, const QStringList& arguments);
+
+            // Sends a request to a running server; false when none is listening.
+            static bool request(const QStringList& arguments, Reply* reply);
+
+        private slots:
+            void accept();
+            void readRequest();
+            void sendReply();
+
+        private:
+            Reply handle(const QStringList& arguments);
+
+            QLocalServer server;
+            Converter converter;
+            QHash<QObject*, QPointer<QLocalSocket> > pending;
+    };
+}
+
+#endif
@@ -0,0 +1,394 @@
+#include "converter.h"
+#include "atomicfile.h"
+#include "memorytracker.h"
+#include "tileencoder.h"
+#include "tilereducer.h"
+
+namespace chrbrew
+{
+    using overbrew::MemoryTracker;
+
+    namespace
+    {
+        const int TILE_HEIGHT = 8;
+
+        // Make needs spaces, '#' and '$' escaped in rule paths.
+        QString makeEscaped(QString path)
+        {
+            path.replace('$', "$$");
+            path.replace('#', "\\#");
+            path.replace(' ', "\\ ");
+            return path;
+        }
+
+        bool writeSmallFile(const QString& filename, const QByteArray& contents, QString* error)
+        {
+            // Patching leaves unchanged files (and their timestamps) alone.
+            overbrew::AtomicFile file(filename, overbrew::AtomicFile::Patch);
+            if(file.open())
+            {
+                file.write(contents);
+                if(file.commit())
+                {
+                    return true;
+                }
+            }
+            *error = file.errorString();
+            return false;
+        }
+
+        struct RunJob
+        {
+            typedef Converter::Result result_type;
+
+            RunJob(Converter* converter)
+                : converter(converter)
+            {
+            }
+
+            result_type operator()(const Converter::Job& job) const
+            {
+                return converter->run(job);
+            }
+
+            Converter* converter;
+        };
+    }
+
+    Converter::Converter(qint64 cacheLimit)
+        : cachedBytes(0), cacheLimit(cacheLimit), useCounter(0)
+    {
+    }
+
+    Converter::~Converter()
+    {
+        MemoryTracker::remove("converter: decoded images");
+    }
+
+    QList<Converter::Job> Converter::parseJobs(const QStringList& arguments, QString* error)
+    {
+        QList<Job> jobs;
+        Job options;
+        QStringList files;
+        for(int i = 0, end = arguments.count(); i != end; ++i)
+        {
+            const auto& argument = arguments[i];
+            if(argument == "--padding")
+            {
+                options.padding = true;
+            }
+            else if(argument == "--tall")
+            {
+                options.tall = true;
+            }
+            else if(argument == "--rle")
+            {
+                options.compression = Codec::RLE;
+            }
+            else if(argument == "--runs")
+            {
+                options.compression = Codec::Runs;
+            }
+            else if(argument == "--patch")
+            {
+                options.patch = true;
+            }
+            else if(argument == "--depfile")
+            {
+                options.depfile = true;
+            }
+            else if(argument == "--force")
+            {
+                options.force = true;
+            }
+            else if(argument == "--fit" && i + 1 != end)
+            {
+                bool ok;
+                options.fitTiles = arguments[++i].toInt(&ok);
+                if(!ok || options.fitTiles < 2)
+                {
+                    *error = QObject::tr("'%1' is not a tile budget (2 or more).").arg(arguments[i]);
+                    return QList<Job>();
+                }
+            }
+            else if(argument == "--conversions" && i + 1 != end)
+            {
+                foreach(const QString& value, arguments[++i].split(','))
+                {
+                    bool ok;
+                    int conversion = value.toInt(&ok);
+                    if(!ok || conversion < 0 || conversion > 15)
+                    {
+                        *error = QObject::tr("'%1' is not a conversion (0 to 15).").arg(value);
+                        return QList<Job>();
+                    }
+                    options.conversions.append(conversion);
+                }
+            }
+            else if(argument.startsWith("--"))
+            {
+                *error = QObject::tr("Unknown option '%1'.").arg(argument);
+                return QList<Job>();
+            }
+            else
+            {
+                files.append(argument);
+            }
+        }
+
+        if(files.isEmpty() || files.count() % 2)
+        {
+            *error = QObject::tr("Expected pairs of input and output files.");
+            return QList<Job>();
+        }
+        for(int i = 0, end = files.count(); i != end; i += 2)
+        {
+            Job job(options);
+            job.input = QFileInfo(files[i]).absoluteFilePath();
+            job.output = QFileInfo(files[i + 1]).absoluteFilePath();
+            jobs.append(job);
+        }
+        return jobs;
+    }
+
+    QImage Converter::loadImage(const QString& filename)
+    {
+        QImage image(filename);
+        return image.isNull() ? image : indexed(image);
+    }
+
+    QImage Converter::indexed(const QImage& source)
+    {
+        auto image = source.convertToFormat(QImage::Format_RGB32, Qt::AvoidDither | Qt::ThresholdDither | Qt::ThresholdAlphaDither);
+        return image.convertToFormat(QImage::Format_Indexed8, Qt::AvoidDither | Qt::ThresholdDither | Qt::ThresholdAlphaDither);
+    }
+
+    QList<int> Converter::automaticConversions(const QImage& image, bool padding)
+    {
+        QList<int> conversions;
+        for(int i = 0, end = image.colorCount(); i != end; ++i)
+        {
+            conversions.append(0);
+        }
+
+        auto colors = image.colorTable();
+        QVector<int> palette(colors.count());
+        for(int i = 0, end = colors.count(); i != end; ++i)
+        {
+            palette[i] = i;
+        }
+        qStableSort(palette.begin(), palette.end(),
+            [&](int a, int b)
+            {
+                return qGray(colors[a]) < qGray(colors[b]);
+            }
+        );
+
+        // Remove padding color.
+        if(padding && image.width() && image.height())
+        {
+            palette.remove(palette.indexOf(image.pixelIndex(0, 0)));
+        }
+
+        // Remove 'transparent' color (fully-saturated colors).
+        auto it = palette.begin();
+        while(it != palette.end())
+        {
+            QRgb color = colors[*it];
+            int r = qRed(color);
+            int g = qGreen(color);
+            int b = qBlue(color);
+            if((r == 0x00 || r == 0xFF)
+                && (g == 0x00 || g == 0xFF)
+                && (b == 0x00 || b == 0xFF)
+                && !(r == 0x00 && g == 0x00 && b == 0x00)
+                && !(r == 0xFF && g == 0xFF && b == 0xFF))
+            {
+                it = palette.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for(int i = 0, end = palette.count(); i != end; ++i)
+        {
+            conversions[palette[i]] = i * 4 / end;
+        }
+        if(palette.count())
+        {
+            conversions[palette[palette.count() - 1]] = 3;
+        }
+        return conversions;
+    }
+
+    QImage Converter::image(const QString& filename)
+    {
+        QFileInfo info(filename);
+        {
+            QMutexLocker lock(&mutex);
+            auto it = images.find(filename);
+            if(it != images.end() && it->modified == info.lastModified() && it->size == info.size())
+            {
+                it->used = ++useCounter;
+                return it->image;
+            }
+        }
+
+        // Decoded outside the lock, so different files load in parallel.
+        CachedImage cached;
+        cached.modified = info.lastModified();
+        cached.size = info.size();
+        cached.image = loadImage(filename);
+        if(!cached.image.isNull())
+        {
+            QMutexLocker lock(&mutex);
+            cachedBytes -= MemoryTracker::bytes(images.take(filename).image);
+            // An image bigger than the whole cache is returned but never kept.
+            if(MemoryTracker::bytes(cached.image) <= cacheLimit)
+            {
+                cached.used = ++useCounter;
+                cachedBytes += MemoryTracker::bytes(cached.image);
+                images.insert(filename, cached);
+                evict();
+            }
+            MemoryTracker::set("converter: decoded images", cachedBytes);
+        }
+        return cached.image;
+    }
+
+    void Converter::evict()
+    {
+        // Oldest first, until the cache fits again. Called with the mutex held.
+        while(cachedBytes > cacheLimit && !images.isEmpty())
+        {
+            auto oldest = images.begin();
+            for(auto it = images.begin(), end = images.end(); it != end; ++it)
+            {
+                if(it->used < oldest->used)
+                {
+                    oldest = it;
+                }
+            }
+            cachedBytes -= MemoryTracker::bytes(oldest->image);
+            images.erase(oldest);
+        }
+    }
+
+    QByteArray Converter::fingerprint(const Job& job, const QByteArray& contents)
+    {
+        QStringList conversions;
+        foreach(int conversion, job.conversions)
+        {
+            conversions.append(QString::number(conversion));
+        }
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(QString("chrbrew;%1;padding=%2;tall=%3;compression=%4;fit=%5;conversions=%6;")
+            .arg(VERSION)
+            .arg(job.padding)
+            .arg(job.tall)
+            .arg(int(job.compression))
+            .arg(job.fitTiles)
+            .arg(conversions.isEmpty() ? QString("auto") : conversions.join(","))
+            .toUtf8());
+        hash.addData(contents);
+        return hash.result().toHex();
+    }
+
+    bool Converter::writeDepfile(const Job& job, QString* error)
+    {
+        return writeSmallFile(job.output + ".d", QString("%1: %2\n").arg(makeEscaped(job.output)).arg(makeEscaped(job.input)).toLocal8Bit(), error);
+    }
+
+    Converter::Result Converter::run(const Job& job)
+    {
+        Result result;
+        result.valid = false;
+        result.skipped = false;
+        result.tiles = 0;
+
+        // Hashing the raw file is much cheaper than decoding it, so check whether the output is current first.
+        QFile input(job.input);
+        if(!input.open(QIODevice::ReadOnly))
+        {
+            result.error = QObject::tr("'%1' could not be opened.").arg(job.input);
+            return result;
+        }
+        auto stamp = fingerprint(job, input.readAll());
+        input.close();
+
+        QFile sidecar(job.output + ".hash");
+        if(!job.force && QFileInfo(job.output).exists() && sidecar.open(QIODevice::ReadOnly) && sidecar.readAll().trimmed() == stamp)
+        {
+            result.skipped = true;
+            result.valid = !job.depfile || QFileInfo(job.output + ".d").exists() || writeDepfile(job, &result.error);
+            if(result.valid && job.fitTiles && !QFileInfo(TileReducer::mapFilename(job.output)).exists())
+            {
+                result.valid = false;
+                result.error = QObject::tr("'%1' is missing; run with --force to rebuild it.").arg(TileReducer::mapFilename(job.output));
+            }
+            return result;
+        }
+        sidecar.close();
+
+        auto source = image(job.input);
+        if(source.isNull())
+        {
+            result.error = QObject::tr("'%1' could not be imported as an image.").arg(job.input);
+            return result;
+        }
+
+        auto conversions = job.conversions.isEmpty() ? automaticConversions(source, job.padding) : job.conversions;
+        int cellHeight = job.tall ? TILE_HEIGHT * 2 : TILE_HEIGHT;
+        auto chr = TileEncoder::encodeImage(source, TileEncoder::lookup(conversions), cellHeight, job.padding ? 1 : 0);
+        if(job.fitTiles)
+        {
+            // The survivors alone can't be indexed, so the cell map is written next to them.
+            auto reduced = TileReducer(chr, cellHeight * 2).reduce(job.fitTiles / (cellHeight / TILE_HEIGHT));
+            if(!reduced.valid)
+            {
+                result.error = reduced.error;
+                return result;
+            }
+            chr = reduced.chr;
+            if(!writeSmallFile(TileReducer::mapFilename(job.output), TileReducer::encodeMap(reduced.map, reduced.uniqueUnits), &result.error))
+            {
+                return result;
+            }
+        }
+
+        overbrew::AtomicFile file(job.output, job.patch ? overbrew::AtomicFile::Patch : overbrew::AtomicFile::Replace);
+        if(!file.open())
+        {
+            result.error = file.errorString();
+            return result;
+        }
+        if(!Codec::compress(job.compression, chr, &file))
+        {
+            result.error = QObject::tr("'%1' uses every byte value, so it can't be RLE packed.").arg(job.input);
+            return result;
+        }
+        if(!file.commit())
+        {
+            result.error = file.errorString();
+            return result;
+        }
+
+        // The sidecar goes last, so an interrupted run is never mistaken for a current one.
+        if((job.depfile && !writeDepfile(job, &result.error)) || !writeSmallFile(job.output + ".hash", stamp + "\n", &result.error))
+        {
+            return result;
+        }
+
+        result.valid = true;
+        result.tiles = chr.size() / TileEncoder::BYTES;
+        return result;
+    }
+
+    QList<Converter::Result> Converter::runAll(const QList<Job>& jobs)
+    {
+        return QtConcurrent::blockingMapped<QList<Result> >(jobs, RunJob(this));
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef CONVERTER_H
+#define CONVERTER_H
+
+#include <QtGui>
+#include "codec.h"
+
+namespace chrbrew
+{
+    // The image to CHR conversion without any widgets, for the command line and the daemon.
+    // Decoded images are kept between jobs and reused while the file is unchanged, up to a byte limit;
+    // past it the least recently used images are dropped.
+    class Converter
+    {
+        public:
+            // Bump when the same inputs and options would give different output, so stale sidecars stop matching.
+            static const int VERSION = 1;
+
+            static const qint64 DEFAULT_CACHE_LIMIT = 256 * 1024 * 1024;
+
+            struct Job
+            {
+                QString input;
+                QString output;
+                bool padding;
+                bool tall;
+                bool patch;
+                bool depfile;
+                bool force;
+                // Above zero, similar tiles are merged until the output has at most this many.
+                int fitTiles;
+                Codec::Type compression;
+                // Empty picks them the same way the editor does.
+                QList<int> conversions;
+
+                Job()
+                    : padding(false), tall(false), patch(false), depfile(false), force(false), fitTiles(0), compression(Codec::None)
+                {
+                }
+            };
+
+            struct Result
+            {
+                bool valid;
+                QString error;
+                // Skipped because the hash sidecar shows the output is current; tiles is then unknown.
+                bool skipped;
+                int tiles;
+            };
+
+            // Parses "[--padding] [--tall] [--rle | --runs] [--patch] [--depfile] [--force] [--fit tiles] [--conversions a,b,...] input output [input output ...]".
+            // --depfile writes a make rule to output.d. Unless --force is given, an output whose output.hash sidecar
+            // matches the input contents, options and tool version is left alone.
+            static QList<Job> parseJobs(const QStringList& arguments, QString* error);
+
+            static QImage loadImage(const QString& filename);
+            static QImage indexed(const QImage& source);
+            static QList<int> automaticConversions(const QImage& image, bool padding);
+
+            explicit Converter(qint64 cacheLimit = DEFAULT_CACHE_LIMIT);
+            ~Converter();
+
+            Result run(const Job& job);
+
+            // Runs the jobs concurrently on the global thread pool; results are in job order.
+            QList<Result> runAll(const QList<Job>& jobs);
+
+        private:
+            struct CachedImage
+            {
+                QDateTime modified;
+                qint64 size;
+                QImage image;
+                quint64 used;
+            };
+
+            QImage image(const QString& filename);
+            void evict();
+
+            static QByteArray fingerprint(const Job& job, const QByteArray& contents);
+            static bool writeDepfile(const Job& job, QString* error);
+
+            QMutex mutex;
+            QHash<QString, CachedImage> images;
+            qint64 cachedBytes;
+            qint64 cacheLimit;
+            quint64 useCounter;
+    };
+}
+
+#endif
@@ -0,0 +1,443 @@
+#include <cstring>
+
+#include "cpu6502.h"
+
+namespace chrbrew
+{
+    namespace
+    {
+        // Subroutines return here, which ends the call.
+        const int HALT = 0xFFF0;
+
+        enum Op
+        {
+            Illegal,
+            ADC, AND, ASL, BCC, BCS, BEQ, BIT, BMI, BNE, BPL, BRK, BVC, BVS, CLC,
+            CLD, CLI, CLV, CMP, CPX, CPY, DEC, DEX, DEY, EOR, INC, INX, INY, JMP,
+            JSR, LDA, LDX, LDY, LSR, NOP, ORA, PHA, PHP, PLA, PLP, ROL, ROR, RTI,
+            RTS, SBC, SEC, SED, SEI, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA
+        };
+
+        enum Mode
+        {
+            Implied, Accumulator, Immediate, ZeroPage, ZeroPageX, ZeroPageY,
+            Absolute, AbsoluteX, AbsoluteY, Indirect, IndirectX, IndirectY, Relative
+        };
+
+        struct Instruction
+        {
+            Op op;
+            Mode mode;
+            int cycles;
+            bool penalty;
+        };
+
+        // Official opcodes only, with base cycle counts. The penalty flag adds a cycle when indexing crosses a page.
+        struct InstructionTable
+        {
+            Instruction entries[256];
+
+            InstructionTable()
+            {
+                for(int i = 0; i != 256; ++i)
+                {
+                    set(i, Illegal, Implied, 0);
+                }
+
+                // Loads, stores and ALU ops sharing the usual eight addressing modes.
+                const Op groups[] = { ORA, AND, EOR, ADC, STA, LDA, CMP, SBC };
+                for(int g = 0; g != 8; ++g)
+                {
+                    int base = g << 5 | 0x01;
+                    bool store = groups[g] == STA;
+                    set(base + 0x00, groups[g], IndirectX, 6);
+                    set(base + 0x04, groups[g], ZeroPage, 3);
+                    if(!store)
+                    {
+                        set(base + 0x08, groups[g], Immediate, 2);
+                    }
+                    set(base + 0x0C, groups[g], Absolute, 4);
+                    set(base + 0x10, groups[g], IndirectY, store ? 6 : 5, !store);
+                    set(base + 0x14, groups[g], ZeroPageX, 4);
+                    set(base + 0x18, groups[g], AbsoluteY, store ? 5 : 4, !store);
+                    set(base + 0x1C, groups[g], AbsoluteX, store ? 5 : 4, !store);
+                }
+
+                // Read-modify-write shifts, increments and decrements.
+                const Op shifts[] = { ASL, ROL, LSR, ROR };
+                for(int g = 0; g != 4; ++g)
+                {
+                    int base = g << 5 | 0x02;
+                    set(base + 0x08, shifts[g], Accumulator, 2);
+                }
+                const Op modify[] = { ASL, ROL, LSR, ROR, DEC, INC };
+                const int modifyBase[] = { 0x06, 0x26, 0x46, 0x66, 0xC6, 0xE6 };
+                for(int g = 0; g != 6; ++g)
+                {
+                    set(modifyBase[g] + 0x00, modify[g], ZeroPage, 5);
+                    set(modifyBase[g] + 0x10, modify[g], ZeroPageX, 6);
+                    set(modifyBase[g] + 0x08, modify[g], Absolute, 6);
+                    set(modifyBase[g] + 0x18, modify[g], AbsoluteX, 7);
+                }
+
+                set(0xA2, LDX, Immediate, 2);
+                set(0xA6, LDX, ZeroPage, 3);
+                set(0xB6, LDX, ZeroPageY, 4);
+                set(0xAE, LDX, Absolute, 4);
+                set(0xBE, LDX, AbsoluteY, 4, true);
+                set(0xA0, LDY, Immediate, 2);
+                set(0xA4, LDY, ZeroPage, 3);
+                set(0xB4, LDY, ZeroPageX, 4);
+                set(0xAC, LDY, Absolute, 4);
+                set(0xBC, LDY, AbsoluteX, 4, true);
+                set(0x86, STX, ZeroPage, 3);
+                set(0x96, STX, ZeroPageY, 4);
+                set(0x8E, STX, Absolute, 4);
+                set(0x84, STY, ZeroPage, 3);
+                set(0x94, STY, ZeroPageX, 4);
+                set(0x8C, STY, Absolute, 4);
+                set(0xE0, CPX, Immediate, 2);
+                set(0xE4, CPX, ZeroPage, 3);
+                set(0xEC, CPX, Absolute, 4);
+                set(0xC0, CPY, Immediate, 2);
+                set(0xC4, CPY, ZeroPage, 3);
+                set(0xCC, CPY, Absolute, 4);
+                set(0x24, BIT, ZeroPage, 3);
+                set(0x2C, BIT, Absolute, 4);
+
+                const Op branches[] = { BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ };
+                for(int g = 0; g != 8; ++g)
+                {
+                    set(g << 5 | 0x10, branches[g], Relative, 2);
+                }
+
+                set(0x4C, JMP, Absolute, 3);
+                set(0x6C, JMP, Indirect, 5);
+                set(0x20, JSR, Absolute, 6);
+                set(0x60, RTS, Implied, 6);
+                set(0x40, RTI, Implied, 6);
+                set(0x00, BRK, Implied, 7);
+
+                set(0x18, CLC, Implied, 2);
+                set(0x38, SEC, Implied, 2);
+                set(0x58, CLI, Implied, 2);
+                set(0x78, SEI, Implied, 2);
+                set(0xB8, CLV, Implied, 2);
+                set(0xD8, CLD, Implied, 2);
+                set(0xF8, SED, Implied, 2);
+                set(0xCA, DEX, Implied, 2);
+                set(0x88, DEY, Implied, 2);
+                set(0xE8, INX, Implied, 2);
+                set(0xC8, INY, Implied, 2);
+                set(0xAA, TAX, Implied, 2);
+                set(0xA8, TAY, Implied, 2);
+                set(0xBA, TSX, Implied, 2);
+                set(0x8A, TXA, Implied, 2);
+                set(0x9A, TXS, Implied, 2);
+                set(0x98, TYA, Implied, 2);
+                set(0xEA, NOP, Implied, 2);
+                set(0x48, PHA, Implied, 3);
+                set(0x08, PHP, Implied, 3);
+                set(0x68, PLA, Implied, 4);
+                set(0x28, PLP, Implied, 4);
+            }
+
+            void set(int opcode, Op op, Mode mode, int cycles, bool penalty = false)
+            {
+                Instruction instruction = { op, mode, cycles, penalty };
+                entries[opcode] = instruction;
+            }
+        };
+
+        const InstructionTable instructions;
+    }
+
+    Cpu6502::Cpu6502()
+        : memory(0x10000, '\0'), a(0), x(0), y(0), s(0xFD), p(Interrupt | Unused), pc(0), count(0)
+    {
+    }
+
+    void Cpu6502::load(int address, const QByteArray& bytes)
+    {
+        std::memcpy(memory.data() + address, bytes.constData(), qMin(bytes.size(), 0x10000 - address));
+    }
+
+    void Cpu6502::poke(int address, quint8 value)
+    {
+        memory[address & 0xFFFF] = char(value);
+    }
+
+    bool Cpu6502::call(int address, qint64 limit)
+    {
+        ppu.clear();
+        message.clear();
+        count = 0;
+        s = 0xFD;
+        push((HALT - 1) >> 8);
+        push((HALT - 1) & 0xFF);
+        pc = address;
+
+        while(pc != HALT)
+        {
+            if(count > limit)
+            {
+                message = QObject::tr("The routine ran for over %1 cycles.").arg(limit);
+                return false;
+            }
+            if(!step())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    qint64 Cpu6502::cycles() const
+    {
+        return count;
+    }
+
+    const QByteArray& Cpu6502::ppuData() const
+    {
+        return ppu;
+    }
+
+    QString Cpu6502::error() const
+    {
+        return message;
+    }
+
+    quint8 Cpu6502::read(int address)
+    {
+        address &= 0xFFFF;
+        // PPU and APU registers read back as open bus; the routines here only write them.
+        if(address >= 0x2000 && address < 0x4020)
+        {
+            return 0;
+        }
+        return memory[address];
+    }
+
+    void Cpu6502::write(int address, quint8 value)
+    {
+        address &= 0xFFFF;
+        if(address == PPUDATA)
+        {
+            ppu.append(char(value));
+        }
+        else if(address < 0x2000 || address >= 0x4020)
+        {
+            memory[address] = char(value);
+        }
+    }
+
+    void Cpu6502::push(quint8 value)
+    {
+        memory[0x100 | s--] = char(value);
+    }
+
+    quint8 Cpu6502::pull()
+    {
+        return memory[0x100 | ++s];
+    }
+
+    void Cpu6502::setZN(quint8 value)
+    {
+        p = (p & ~(Zero | Negative)) | (value ? 0 : Zero) | (value & Negative);
+    }
+
+    void Cpu6502::compare(quint8 reg, quint8 value)
+    {
+        p = (p & ~Carry) | (reg >= value ? Carry : 0);
+        setZN(reg - value);
+    }
+
+    void Cpu6502::adc(quint8 value)
+    {
+        // The NES CPU has no decimal mode.
+        int sum = a + value + (p & Carry);
+        p = (p & ~(Carry | Overflow)) | (sum > 0xFF ? Carry : 0) | ((~(a ^ value) & (a ^ sum) & 0x80) ? Overflow : 0);
+        a = sum;
+        setZN(a);
+    }
+
+    bool Cpu6502::step()
+    {
+        int opcode = read(pc++);
+        const auto& instruction = instructions.entries[opcode];
+        if(instruction.op == Illegal || instruction.op == BRK)
+        {
+            message = QObject::tr("The routine hit opcode $%1 at $%2.").arg(opcode, 2, 16, QChar('0')).arg(pc - 1, 4, 16, QChar('0'));
+            return false;
+        }
+        count += instruction.cycles;
+
+        int address = 0;
+        int base = 0;
+        switch(instruction.mode)
+        {
+            case Implied:
+            case Accumulator:
+                break;
+            case Immediate:
+                address = pc++;
+                break;
+            case ZeroPage:
+                address = read(pc++);
+                break;
+            case ZeroPageX:
+                address = (read(pc++) + x) & 0xFF;
+                break;
+            case ZeroPageY:
+                address = (read(pc++) + y) & 0xFF;
+                break;
+            case Absolute:
+                address = read(pc) | read(pc + 1) << 8;
+                pc += 2;
+                break;
+            case AbsoluteX:
+            case AbsoluteY:
+                base = read(pc) | read(pc + 1) << 8;
+                pc += 2;
+                address = (base + (instruction.mode == AbsoluteX ? x : y)) & 0xFFFF;
+                break;
+            case Indirect:
+                // The pointer's high byte never carries into the next page.
+                base = read(pc) | read(pc + 1) << 8;
+                pc += 2;
+                address = read(base) | read((base & 0xFF00) | ((base + 1) & 0xFF)) << 8;
+                break;
+            case IndirectX:
+                base = (read(pc++) + x) & 0xFF;
+                address = read(base) | read((base + 1) & 0xFF) << 8;
+                break;
+            case IndirectY:
+                base = read(pc++);
+                base = read(base) | read((base + 1) & 0xFF) << 8;
+                address = (base + y) & 0xFFFF;
+                break;
+            case Relative:
+                base = qint8(read(pc++));
+                address = (pc + base) & 0xFFFF;
+                break;
+        }
+        if(instruction.penalty && ((base ^ address) & 0xFF00))
+        {
+            ++count;
+        }
+
+        switch(instruction.op)
+        {
+            case ADC: adc(read(address)); break;
+            case SBC: adc(~read(address)); break;
+            case AND: a &= read(address); setZN(a); break;
+            case ORA: a |= read(address); setZN(a); break;
+            case EOR: a ^= read(address); setZN(a); break;
+            case CMP: compare(a, read(address)); break;
+            case CPX: compare(x, read(address)); break;
+            case CPY: compare(y, read(address)); break;
+            case BIT:
+            {
+                quint8 value = read(address);
+                p = (p & ~(Zero | Overflow | Negative)) | ((a & value) ? 0 : Zero) | (value & (Overflow | Negative));
+                break;
+            }
+            case ASL:
+            case LSR:
+            case ROL:
+            case ROR:
+            {
+                int value = instruction.mode == Accumulator ? a : read(address);
+                int carry = p & Carry;
+                int result;
+                if(instruction.op == ASL || instruction.op == ROL)
+                {
+                    p = (p & ~Carry) | ((value & 0x80) ? Carry : 0);
+                    result = (value << 1 | (instruction.op == ROL ? carry : 0)) & 0xFF;
+                }
+                else
+                {
+                    p = (p & ~Carry) | (value & 0x01);
+                    result = value >> 1 | (instruction.op == ROR && carry ? 0x80 : 0);
+                }
+                setZN(result);
+                if(instruction.mode == Accumulator)
+                {
+                    a = result;
+                }
+                else
+                {
+                    write(address, result);
+                }
+                break;
+            }
+            case INC: { quint8 value = read(address) + 1; write(address, value); setZN(value); break; }
+            case DEC: { quint8 value = read(address) - 1; write(address, value); setZN(value); break; }
+            case INX: setZN(++x); break;
+            case INY: setZN(++y); break;
+            case DEX: setZN(--x); break;
+            case DEY: setZN(--y); break;
+            case LDA: a = read(address); setZN(a); break;
+            case LDX: x = read(address); setZN(x); break;
+            case LDY: y = read(address); setZN(y); break;
+            case STA: write(address, a); break;
+            case STX: write(address, x); break;
+            case STY: write(address, y); break;
+            case TAX: x = a; setZN(x); break;
+            case TAY: y = a; setZN(y); break;
+            case TSX: x = s; setZN(x); break;
+            case TXA: a = x; setZN(a); break;
+            case TYA: a = y; setZN(a); break;
+            case TXS: s = x; break;
+            case PHA: push(a); break;
+            case PHP: push(p | Break | Unused); break;
+            case PLA: a = pull(); setZN(a); break;
+            case PLP: p = (pull() & ~Break) | Unused; break;
+            case BPL: branch(!(p & Negative), address); break;
+            case BMI: branch(p & Negative, address); break;
+            case BVC: branch(!(p & Overflow), address); break;
+            case BVS: branch(p & Overflow, address); break;
+            case BCC: branch(!(p & Carry), address); break;
+            case BCS: branch(p & Carry, address); break;
+            case BNE: branch(!(p & Zero), address); break;
+            case BEQ: branch(p & Zero, address); break;
+            case JMP: pc = address; break;
+            case JSR:
+                push((pc - 1) >> 8);
+                push((pc - 1) & 0xFF);
+                pc = address;
+                break;
+            case RTS:
+                pc = pull();
+                pc = (pc | pull() << 8) + 1;
+                break;
+            case RTI:
+                p = (pull() & ~Break) | Unused;
+                pc = pull();
+                pc |= pull() << 8;
+                break;
+            case CLC: p &= ~Carry; break;
+            case SEC: p |= Carry; break;
+            case CLI: p &= ~Interrupt; break;
+            case SEI: p |= Interrupt; break;
+            case CLV: p &= ~Overflow; break;
+            case CLD: p &= ~Decimal; break;
+            case SED: p |= Decimal; break;
+            case NOP: break;
+            case Illegal:
+            case BRK:
+                break;
+        }
+        return true;
+    }
+
+    void Cpu6502::branch(bool taken, int address)
+    {
+        // A taken branch costs a cycle, and another if it lands on a different page.
+        if(taken)
+        {
+            count += ((pc ^ address) & 0xFF00) ? 2 : 1;
+            pc = address;
+        }
+    }
+}
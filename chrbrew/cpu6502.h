@@ -0,0 +1,64 @@
+#ifndef CPU6502_H
+#define CPU6502_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Just enough of an NES to time a decompression routine: a cycle-counted 6502 with flat memory,
+    // where every byte written to PPUDATA ($2007) is collected instead of reaching VRAM.
+    class Cpu6502
+    {
+        public:
+            static const int PPUDATA = 0x2007;
+
+            Cpu6502();
+
+            void load(int address, const QByteArray& bytes);
+            void poke(int address, quint8 value);
+
+            // Runs the subroutine at address until it returns, or until the cycle limit is hit.
+            bool call(int address, qint64 limit);
+
+            qint64 cycles() const;
+            const QByteArray& ppuData() const;
+            QString error() const;
+
+        private:
+            enum
+            {
+                Carry = 0x01,
+                Zero = 0x02,
+                Interrupt = 0x04,
+                Decimal = 0x08,
+                Break = 0x10,
+                Unused = 0x20,
+                Overflow = 0x40,
+                Negative = 0x80
+            };
+
+            bool step();
+
+            quint8 read(int address);
+            void write(int address, quint8 value);
+            void push(quint8 value);
+            quint8 pull();
+            void setZN(quint8 value);
+            void branch(bool taken, int address);
+            void compare(quint8 reg, quint8 value);
+            void adc(quint8 value);
+
+            QByteArray memory;
+            QByteArray ppu;
+            QString message;
+            quint8 a;
+            quint8 x;
+            quint8 y;
+            quint8 s;
+            quint8 p;
+            quint16 pc;
+            qint64 count;
+    };
+}
+
+#endif
@@ -0,0 +1,301 @@
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ditherer.h"
+
+namespace chrbrew
+{
+    namespace
+    {
+        // Values are luminance x 3 x 16, so shade k sits at k * STEP and error keeps 4 fractional bits.
+        const int STEP = 255 * 16;
+
+        const int bayer[4][4] = {
+            { 0, 8, 2, 10 },
+            { 12, 4, 14, 6 },
+            { 3, 11, 1, 9 },
+            { 15, 7, 13, 5 },
+        };
+
+        int luminance(QRgb color)
+        {
+            return (qRed(color) * 77 + qGreen(color) * 150 + qBlue(color) * 29) >> 8;
+        }
+
+        int quantize(int value)
+        {
+            return qBound(0, (value + STEP / 2) / STEP, 3);
+        }
+
+        // Bayer threshold offsets span one shade step, centered on zero.
+        int orderedOffset(int x, int y, int strength)
+        {
+            return (2 * bayer[y & 3][x & 3] - 15) * STEP / 32 * strength / 100;
+        }
+
+        void orderedRow(const QRgb* source, uchar* dest, int width, int y, int strength)
+        {
+            int x = 0;
+#ifdef __SSE2__
+            // Four pixels at a time: weighted channel sums for luminance, then three threshold compares give the shade.
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+            const __m128i offsets = _mm_setr_epi32(orderedOffset(0, y, strength), orderedOffset(1, y, strength),
+                orderedOffset(2, y, strength), orderedOffset(3, y, strength));
+            const __m128i threshold1 = _mm_set1_epi32(STEP / 2 - 1);
+            const __m128i threshold2 = _mm_set1_epi32(STEP * 3 / 2 - 1);
+            const __m128i threshold3 = _mm_set1_epi32(STEP * 5 / 2 - 1);
+            for(; x + 4 <= width; x += 4)
+            {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+                __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+                __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+                __m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
+                __m128i luma = _mm_srli_epi32(_mm_add_epi32(even, odd), 8);
+
+                // luma x 48, as shifts, since SSE2 has no 32-bit multiply.
+                __m128i value = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(luma, 5), _mm_slli_epi32(luma, 4)), offsets);
+                __m128i shade = _mm_sub_epi32(zero, _mm_add_epi32(_mm_add_epi32(
+                    _mm_cmpgt_epi32(value, threshold1),
+                    _mm_cmpgt_epi32(value, threshold2)),
+                    _mm_cmpgt_epi32(value, threshold3)));
+                shade = _mm_packus_epi16(_mm_packs_epi32(shade, zero), zero);
+                int packed = _mm_cvtsi128_si32(shade);
+                memcpy(dest + x, &packed, 4);
+            }
+#endif
+            for(; x != width; ++x)
+            {
+                dest[x] = quantize(luminance(source[x]) * 48 + orderedOffset(x, y, strength));
+            }
+        }
+
+        struct OrderedRow
+        {
+            OrderedRow(const QImage* source, uchar* bits, int bytesPerLine, int strength)
+                : source(source), bits(bits), bytesPerLine(bytesPerLine), strength(strength)
+            {
+            }
+
+            void operator()(int y) const
+            {
+                orderedRow(reinterpret_cast<const QRgb*>(source->constScanLine(y)), bits + y * bytesPerLine, source->width(), y, strength);
+            }
+
+            const QImage* source;
+            uchar* bits;
+            int bytesPerLine;
+            int strength;
+        };
+
+        struct Diffusion
+        {
+            const QImage* source;
+            uchar* bits;
+            int bytesPerLine;
+            int width;
+            int height;
+            int block;
+            int strength;
+            // Error carried into each row, written by the row above; a spare entry on each side.
+            int* error;
+            // Pixels finished in each row. A row may do pixel x once the row above has finished x + 1.
+            QAtomicInt* progress;
+            QAtomicInt nextRow;
+        };
+
+        void diffuseRow(Diffusion& state, int y)
+        {
+            int w = state.width;
+            auto line = reinterpret_cast<const QRgb*>(state.source->constScanLine(y));
+            auto dest = state.bits + y * state.bytesPerLine;
+            auto in = state.error + y * (w + 2) + 1;
+            auto out = in + w + 2;
+            auto above = y ? &state.progress[y - 1] : 0;
+            auto& done = state.progress[y];
+            bool lastInBlock = state.block && (y + 1) % state.block == 0;
+            bool spill = !lastInBlock && y + 1 != state.height;
+
+            int carry = 0;
+            for(int x = 0; x != w; ++x)
+            {
+                if(above)
+                {
+                    int needed = qMin(x + 2, w);
+                    while(above->fetchAndAddAcquire(0) < needed)
+                    {
+                        QThread::yieldCurrentThread();
+                    }
+                }
+
+                bool blockStart = state.block && x % state.block == 0;
+                bool blockEnd = state.block && (x + 1) % state.block == 0;
+                if(blockStart)
+                {
+                    carry = 0;
+                }
+
+                int value = luminance(line[x]) * 48 + in[x] + carry;
+                int shade = quantize(value);
+                dest[x] = shade;
+                int error = (value - shade * STEP) * state.strength / 100;
+
+                carry = blockEnd ? 0 : error * 7 / 16;
+                if(spill)
+                {
+                    if(!blockStart)
+                    {
+                        out[x - 1] += error * 3 / 16;
+                    }
+                    out[x] += error * 5 / 16;
+                    if(!blockEnd)
+                    {
+                        out[x + 1] += error / 16;
+                    }
+                }
+                done.fetchAndStoreRelease(x + 1);
+            }
+        }
+
+        struct DiffuseWorker
+        {
+            DiffuseWorker(Diffusion* state)
+                : state(state)
+            {
+            }
+
+            void operator()(int) const
+            {
+                forever
+                {
+                    int y = state->nextRow.fetchAndAddOrdered(1);
+                    if(y >= state->height)
+                    {
+                        return;
+                    }
+                    diffuseRow(*state, y);
+                }
+            }
+
+            Diffusion* state;
+        };
+    }
+
+    Ditherer::Ditherer(Mode mode, int strength, int paddedCellHeight)
+        : mode(mode), strength(qBound(0, strength, 100)), cellHeight(paddedCellHeight)
+    {
+    }
+
+    QString Ditherer::name(Mode mode)
+    {
+        switch(mode)
+        {
+            case None: return QObject::tr("None");
+            case Ordered: return QObject::tr("Ordered (Bayer 4x4)");
+            case FloydSteinberg: return QObject::tr("Floyd-Steinberg");
+            case TileFloydSteinberg: return QObject::tr("Floyd-Steinberg, per tile");
+            case AttributeFloydSteinberg: return QObject::tr("Floyd-Steinberg, per attribute area");
+            default: return QString();
+        }
+    }
+
+    QImage Ditherer::apply(const QImage& source) const
+    {
+        auto rgb = source.convertToFormat(QImage::Format_RGB32);
+        if(!cellHeight)
+        {
+            return dither(rgb);
+        }
+
+        // Only the cells are dithered, packed together, then put back on a grid of the padding color.
+        const int cellWidth = 8;
+        int columns = rgb.width() / (cellWidth + 1);
+        int rows = rgb.height() / (cellHeight + 1);
+        QImage cells(columns * cellWidth, rows * cellHeight, QImage::Format_RGB32);
+        for(int y = 0, end = cells.height(); y != end; ++y)
+        {
+            auto line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y / cellHeight * (cellHeight + 1) + 1 + y % cellHeight));
+            auto dest = reinterpret_cast<QRgb*>(cells.scanLine(y));
+            for(int c = 0; c != columns; ++c)
+            {
+                memcpy(dest + c * cellWidth, line + c * (cellWidth + 1) + 1, cellWidth * sizeof(QRgb));
+            }
+        }
+        auto dithered = dither(cells);
+
+        QImage result(rgb.width(), rgb.height(), QImage::Format_Indexed8);
+        auto colors = dithered.colorTable();
+        colors.append(rgb.width() && rgb.height() ? rgb.pixel(0, 0) : qRgb(0xFF, 0x00, 0xFF));
+        result.setColorTable(colors);
+        result.fill(PADDING_INDEX);
+        for(int y = 0, end = dithered.height(); y != end; ++y)
+        {
+            auto line = dithered.constScanLine(y);
+            auto dest = result.scanLine(y / cellHeight * (cellHeight + 1) + 1 + y % cellHeight);
+            for(int c = 0; c != columns; ++c)
+            {
+                memcpy(dest + c * (cellWidth + 1) + 1, line + c * cellWidth, cellWidth);
+            }
+        }
+        return result;
+    }
+
+    QImage Ditherer::dither(const QImage& rgb) const
+    {
+        int w = rgb.width();
+        int h = rgb.height();
+
+        QImage result(w, h, QImage::Format_Indexed8);
+        result.setColorCount(4);
+        for(int i = 0; i != 4; ++i)
+        {
+            result.setColor(i, qRgb(i * 85, i * 85, i * 85));
+        }
+        if(!w || !h)
+        {
+            return result;
+        }
+
+        // Workers write through bits(), detached here, once.
+        auto bits = result.bits();
+
+        if(mode == None || mode == Ordered)
+        {
+            // Rows are independent; each is quantized a vector at a time.
+            QList<int> rows;
+            for(int y = 0; y != h; ++y)
+            {
+                rows.append(y);
+            }
+            QtConcurrent::blockingMap(rows, OrderedRow(&rgb, bits, result.bytesPerLine(), mode == Ordered ? strength : 0));
+            return result;
+        }
+
+        QVector<int> error((h + 1) * (w + 2), 0);
+        QVector<QAtomicInt> progress(h);
+        Diffusion state;
+        state.source = &rgb;
+        state.bits = bits;
+        state.bytesPerLine = result.bytesPerLine();
+        state.width = w;
+        state.height = h;
+        state.block = mode == TileFloydSteinberg ? 8 : mode == AttributeFloydSteinberg ? 16 : 0;
+        state.strength = strength;
+        state.error = error.data();
+        state.progress = progress.data();
+        state.nextRow = 0;
+
+        // Wavefront: workers claim rows in order and trail the row above by two pixels. A claimed row's
+        // predecessor was claimed earlier by a worker that is already running, so waiting can't deadlock.
+        QList<int> workers;
+        for(int i = 0, end = qMin(qMax(QThread::idealThreadCount(), 1), h); i != end; ++i)
+        {
+            workers.append(i);
+        }
+        QtConcurrent::blockingMap(workers, DiffuseWorker(&state));
+        return result;
+    }
+}
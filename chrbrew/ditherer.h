@@ -0,0 +1,45 @@
+#ifndef DITHERER_H
+#define DITHERER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Reduces a full-color image to 4 shades of gray (indexes 0 .. 3, darkest first), so gradients
+    // survive the trip to 2-bit tiles instead of banding.
+    class Ditherer
+    {
+        public:
+            enum Mode
+            {
+                None,
+                Ordered,
+                FloydSteinberg,
+                // Error never leaves its 8x8 tile, so repeated source tiles stay identical.
+                TileFloydSteinberg,
+                // Error never leaves its 16x16 attribute area, which may be given a different palette.
+                AttributeFloydSteinberg,
+                ModeCount
+            };
+
+            // Shade 4 in a padded result is the padding, in the source's padding color.
+            static const int PADDING_INDEX = 4;
+
+            // A padded source has a 1 pixel grid before every 8 x cellHeight cell. The grid is kept out of the
+            // dithering, so no error crosses it and the tile and attribute blocks line up with the cells.
+            Ditherer(Mode mode, int strength, int paddedCellHeight = 0);
+
+            static QString name(Mode mode);
+
+            QImage apply(const QImage& source) const;
+
+        private:
+            QImage dither(const QImage& rgb) const;
+
+            Mode mode;
+            int strength;
+            int cellHeight;
+    };
+}
+
+#endif
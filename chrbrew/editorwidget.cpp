@@ -1,54 +1,72 @@
+#include <climits>
 #include <QMessageBox>
 
 #include "editorwidget.h"
+#include "animationstreamer.h"
+#include "atomicfile.h"
+#include "codec.h"
+#include "converter.h"
+#include "memorytracker.h"
+#include "ditherer.h"
+#include "mapimporter.h"
+#include "metatilebuilder.h"
+#include "rompatcher.h"
+#include "screenconverter.h"
+#include "tileencoder.h"
+#include "tilereducer.h"
 
 namespace chrbrew
 {
-    QVector<int> EditorWidget::orderedPalette(const QImage& source)
+    using overbrew::AtomicFile;
+    using overbrew::MemoryTracker;
+
+    namespace
     {
-        auto colors = source.colorTable();
-        QVector<int> palette(colors.count());
-        for(int i = 0, end = colors.count(); i != end; ++i)
+        // Copies one row of padded cells into the unpadded image.
+        struct StripRow
         {
-            palette[i] = i;
-        }
-        qStableSort(palette.begin(), palette.end(),
-            [&](int a, int b)
+            StripRow(const QImage* source, uchar* bits, int bytesPerLine, int columns, int cellHeight, int cellWidth)
+                : source(source), bits(bits), bytesPerLine(bytesPerLine), columns(columns), cellHeight(cellHeight), cellWidth(cellWidth)
             {
-                return qGray(colors[a]) < qGray(colors[b]);
             }
-        );
-        return palette;
+
+            void operator()(int r) const
+            {
+                for(int y = 0; y != cellHeight; ++y)
+                {
+                    auto line = source->constScanLine(r * (cellHeight + 1) + 1 + y);
+                    auto dest = bits + (r * cellHeight + y) * bytesPerLine;
+                    for(int c = 0; c != columns; ++c)
+                    {
+                        memcpy(dest + c * cellWidth, line + c * (cellWidth + 1) + 1, cellWidth);
+                    }
+                }
+            }
+
+            const QImage* source;
+            uchar* bits;
+            int bytesPerLine;
+            int columns;
+            int cellHeight;
+            int cellWidth;
+        };
     }
 
-    QImage EditorWidget::stripPadding(const QImage& source)
+    QImage EditorWidget::stripPadding(const QImage& source, int cellHeight)
     {
         int columns(source.width() / (TILE_WIDTH + 1));
-        int rows(source.height() / (TILE_HEIGHT + 1));
+        int rows(source.height() / (cellHeight + 1));
 
-        QImage result(QSize(columns * TILE_WIDTH, rows * TILE_HEIGHT), QImage::Format_Indexed8);
+        QImage result(QSize(columns * TILE_WIDTH, rows * cellHeight), QImage::Format_Indexed8);
         result.setColorTable(source.colorTable());
 
+        // Tile rows are independent, so they're copied concurrently; bits() detaches once, up front.
+        QList<int> tileRows;
         for(int r = 0; r != rows; ++r)
         {
-            for(int c = 0; c != columns; ++c)
-            {
-                for(int y = 0; y != TILE_HEIGHT; ++y)
-                {
-                    for(int x = 0; x != TILE_WIDTH; ++x)
-                    {
-                        result.setPixel(
-                            c * TILE_WIDTH + x,
-                            r * TILE_HEIGHT + y,
-                            source.pixelIndex(
-                                c * (TILE_WIDTH + 1) + 1 + x,
-                                r * (TILE_HEIGHT + 1) + 1 + y
-                            )
-                        );
-                    }
-                }
-            }
+            tileRows.append(r);
         }
+        QtConcurrent::blockingMap(tileRows, StripRow(&source, result.bits(), result.bytesPerLine(), columns, cellHeight, TILE_WIDTH));
         return result;
     }
 
@@ -106,7 +124,8 @@ namespace chrbrew
 
             paletteHelpLabel = new QLabel(tr(
                 "0 .. 3 are valid color indexes.<br>"
-                "0 = transparent in sprites."
+                "0 = transparent in sprites.<br>"
+                "Add 4 x palette (0 .. 3) to pick a metatile palette."
             ));
             paletteHelpLabel->hide();
             groupLayout->addWidget(paletteHelpLabel);
@@ -127,20 +146,88 @@ namespace chrbrew
 
                 tilesLabel = new QLabel(tr("Output Tiles: 0"));
                 groupLayout->addWidget(tilesLabel);
+
+                metatilesLabel = new QLabel(tr("Metatiles: 0"));
+                groupLayout->addWidget(metatilesLabel);
+            }
+            if(auto group = new QGroupBox(tr("Tile Budget")))
+            {
+                rowLayout->addWidget(group);
+
+                auto groupLayout = new QGridLayout();
+                group->setLayout(groupLayout);
+
+                // Merges the most alike tiles until the output fits; changed cells are outlined in the preview.
+                fitOption = new QCheckBox(tr("Fit to"));
+                groupLayout->addWidget(fitOption, 0, 0);
+
+                fitSpinBox = new QSpinBox();
+                fitSpinBox->setRange(2, 4096);
+                fitSpinBox->setValue(256);
+                fitSpinBox->setSuffix(tr(" tiles"));
+                groupLayout->addWidget(fitSpinBox, 0, 1);
+
+                fitLabel = new QLabel();
+                groupLayout->addWidget(fitLabel, 1, 0, 1, 2);
             }
             if(auto group = new QGroupBox(tr("Output Compression")))
             {
                 rowLayout->addWidget(group);
 
-                auto groupLayout = new QVBoxLayout();
+                auto groupLayout = new QGridLayout();
                 group->setLayout(groupLayout);
 
                 compressionNone = new QRadioButton(tr("None"));
                 compressionNone->setChecked(true);
-                groupLayout->addWidget(compressionNone);
+                groupLayout->addWidget(compressionNone, 0, 0);
 
                 compressionRLE = new QRadioButton(tr("RLE (Run-Length Encoding)"));
-                groupLayout->addWidget(compressionRLE);
+                groupLayout->addWidget(compressionRLE, 1, 0);
+
+                compressionRuns = new QRadioButton(tr("Runs (Counted Runs and Literals)"));
+                groupLayout->addWidget(compressionRuns, 2, 0);
+
+                // Size and decode time on a 6502, filled in on request.
+                for(int i = 0; i != Codec::TypeCount; ++i)
+                {
+                    compressionCostLabels[i] = new QLabel();
+                    groupLayout->addWidget(compressionCostLabels[i], i, 1);
+                }
+
+                measureButton = new QPushButton(tr("&Measure Load Time"));
+                measureButton->setEnabled(false);
+                groupLayout->addWidget(measureButton, Codec::TypeCount, 0, 1, 2);
+
+                // Unchanged output keeps its timestamp, so build tools don't see a change.
+                patchOption = new QCheckBox(tr("Only rewrite changed pages"));
+                groupLayout->addWidget(patchOption, Codec::TypeCount + 1, 0, 1, 2);
+            }
+            if(auto group = new QGroupBox(tr("Animation")))
+            {
+                rowLayout->addWidget(group);
+
+                auto groupLayout = new QFormLayout();
+                group->setLayout(groupLayout);
+
+                budgetSpinBox = new QSpinBox();
+                budgetSpinBox->setRange(TILE_WIDTH * 2, AnimationStreamer::MAX_VBLANK_TILES * TileEncoder::BYTES);
+                budgetSpinBox->setSingleStep(16);
+                budgetSpinBox->setValue(256);
+                groupLayout->addRow(tr("Bytes/Vblank"), budgetSpinBox);
+
+                durationSpinBox = new QSpinBox();
+                durationSpinBox->setRange(1, 255);
+                durationSpinBox->setValue(8);
+                groupLayout->addRow(tr("Frame Vblanks"), durationSpinBox);
+
+                frameHeightSpinBox = new QSpinBox();
+                frameHeightSpinBox->setRange(0, 4096);
+                frameHeightSpinBox->setSingleStep(TILE_HEIGHT);
+                frameHeightSpinBox->setSpecialValueText(tr("Whole Image"));
+                groupLayout->addRow(tr("Frame Height"), frameHeightSpinBox);
+
+                animationLabel = new QLabel();
+                groupLayout->addRow(animationLabel);
             }
             if(auto group = new QGroupBox(tr("Options")))
             {
@@ -153,6 +240,42 @@ namespace chrbrew
                 paddingOption->setChecked(true);
                 padding = paddingOption->isChecked();
                 groupLayout->addWidget(paddingOption);
+
+                tallOption = new QCheckBox(tr("8x16 Sprites"));
+                tallOption->setChecked(false);
+                tall = tallOption->isChecked();
+                groupLayout->addWidget(tallOption);
+
+                screenOption = new QCheckBox(tr("Screen (Nametable)"));
+                screenOption->setChecked(false);
+                screen = screenOption->isChecked();
+                groupLayout->addWidget(screenOption);
+
+                // spritebrew can follow the output tiles as they change, without anything being saved.
+                shareOption = new QCheckBox(tr("Share with spritebrew"));
+                shareOption->setChecked(true);
+                groupLayout->addWidget(shareOption);
+            }
+            if(auto group = new QGroupBox(tr("Dither")))
+            {
+                rowLayout->addWidget(group);
+
+                auto groupLayout = new QHBoxLayout();
+                group->setLayout(groupLayout);
+
+                // Dithered images come in as 4 grays, so gradients don't band once they're mapped to 2-bit colors.
+                ditherModeBox = new QComboBox();
+                for(int i = 0; i != Ditherer::ModeCount; ++i)
+                {
+                    ditherModeBox->addItem(Ditherer::name(Ditherer::Mode(i)));
+                }
+                groupLayout->addWidget(ditherModeBox);
+
+                ditherStrengthSpinBox = new QSpinBox();
+                ditherStrengthSpinBox->setRange(0, 100);
+                ditherStrengthSpinBox->setValue(100);
+                ditherStrengthSpinBox->setSuffix(tr("%"));
+                groupLayout->addWidget(ditherStrengthSpinBox);
             }
         }
         if(auto group = new QGroupBox(tr("Preview")))
@@ -175,6 +298,21 @@ namespace chrbrew
 
         connect(imageBrowseButton, SIGNAL(clicked()), this, SLOT(browse()));
         connect(paddingOption, SIGNAL(toggled(bool)), this, SLOT(toggledPadding(bool)));
+        connect(tallOption, SIGNAL(toggled(bool)), this, SLOT(toggledTall(bool)));
+        connect(shareOption, SIGNAL(toggled(bool)), this, SLOT(toggledShare(bool)));
+        connect(screenOption, SIGNAL(toggled(bool)), this, SLOT(toggledScreen(bool)));
+        connect(measureButton, SIGNAL(clicked()), this, SLOT(measureCompression()));
+        connect(fitOption, SIGNAL(toggled(bool)), this, SLOT(fitChanged()));
+        connect(ditherModeBox, SIGNAL(currentIndexChanged(int)), this, SLOT(ditherChanged()));
+        connect(ditherStrengthSpinBox, SIGNAL(valueChanged(int)), this, SLOT(ditherChanged()));
+        connect(fitSpinBox, SIGNAL(valueChanged(int)), this, SLOT(fitChanged()));
+
+        loading = false;
+    }
+
+    EditorWidget::~EditorWidget()
+    {
+        MemoryTracker::removeAll("chrbrew: ");
     }
 
     void EditorWidget::browse()
@@ -201,12 +339,137 @@ namespace chrbrew
         if(!loading)
         {
             padding = checked;
+            if(ditherModeBox->currentIndex() != Ditherer::None)
+            {
+                // The padding grid changes which pixels are dithered.
+                requantize();
+            }
             autoFillConversions();
             calculatePalette();
             calculatePreview();
         }
     }
 
+    void EditorWidget::toggledTall(bool checked)
+    {
+        if(!loading)
+        {
+            tall = checked;
+            if(!chrData.isEmpty())
+            {
+                // Re-layout the character set as top/bottom pairs.
+                decodeCHR();
+                imageLabel->setPixmap(QPixmap::fromImage(image));
+            }
+            else if(padding && ditherModeBox->currentIndex() != Ditherer::None)
+            {
+                // Taller cells move the padding grid the dithering skips.
+                requantize();
+            }
+            calculatePreview();
+        }
+    }
+
+    void EditorWidget::toggledScreen(bool checked)
+    {
+        if(!loading)
+        {
+            // Screens are unpadded 8x8 background tiles.
+            screen = checked;
+            if(checked)
+            {
+                paddingOption->setChecked(false);
+                tallOption->setChecked(false);
+            }
+            paddingOption->setEnabled(!checked);
+            tallOption->setEnabled(!checked);
+        }
+    }
+
+    void EditorWidget::toggledShare(bool checked)
+    {
+        if(checked && !tiles.isEmpty())
+        {
+            sharedCHR.publish(tiles.bytes());
+        }
+    }
+
+    void EditorWidget::measureCompression()
+    {
+        for(int i = 0; i != Codec::TypeCount; ++i)
+        {
+            auto cost = Codec::measure(Codec::Type(i), tiles.bytes());
+            if(cost.valid)
+            {
+                compressionCostLabels[i]->setText(tr("%1 byte(s), %2 cycles/tile, %3 cycles/bank")
+                    .arg(cost.size)
+                    .arg(cost.tiles ? cost.cycles / cost.tiles : 0)
+                    .arg(cost.worstBankCycles)
+                );
+            }
+            else
+            {
+                compressionCostLabels[i]->setText(cost.error);
+            }
+        }
+    }
+
+    void EditorWidget::ditherChanged()
+    {
+        if(!loading)
+        {
+            requantize();
+            calculatePreview();
+        }
+    }
+
+    void EditorWidget::requantize()
+    {
+        if(!chrData.isEmpty() || imageFilename.isEmpty())
+        {
+            return;
+        }
+
+        // The undithered source isn't kept, so it's decoded again whenever the dithering changes.
+        QImage original(imageFilename);
+        if(original.isNull())
+        {
+            return;
+        }
+        int colorCount = image.colorCount();
+        image = quantize(original);
+        if(image.colorCount() != colorCount)
+        {
+            // The conversions are per color, so only a different number of colors starts them over.
+            loading = true;
+            setupImage(imageFilename);
+            loading = false;
+            return;
+        }
+
+        imageLabel->setPixmap(QPixmap::fromImage(image));
+        for(int i = 0; i != colorCount; ++i)
+        {
+            sourcePalette->itemAt(i)->widget()->setPalette(QPalette(QColor(image.color(i))));
+        }
+    }
+
+    QImage EditorWidget::quantize(const QImage& source) const
+    {
+        auto mode = Ditherer::Mode(ditherModeBox->currentIndex());
+        if(mode == Ditherer::None)
+        {
+            return Converter::indexed(source);
+        }
+        int cellHeight = tall ? TILE_HEIGHT * 2 : TILE_HEIGHT;
+        return Ditherer(mode, ditherStrengthSpinBox->value(), padding ? cellHeight : 0).apply(source);
+    }
+
+    void EditorWidget::fitChanged()
+    {
+        calculatePreview();
+    }
+
     void EditorWidget::conversionChanged(const QString& text)
     {
         calculatePalette();
@@ -220,13 +483,52 @@ namespace chrbrew
 
         loading = true;
 
-        if(suffix == "chr")
+        // Anything decoded before with the same contents and options comes from the cache.
+        // CHR sheets use the layout-only key, so spritebrew's decodes of the same file hit here too.
+        QByteArray cacheKey;
+        AssetCache::Entry cached;
+        QFile file(filename);
+        if(file.open(QIODevice::ReadOnly))
         {
-            success = readCHR(filename);
-            if(success)
+            if(suffix == "chr")
             {
-                setupImage(filename);
+                cacheKey = AssetCache::sheetKey(file.read(file.size() / TileStore::BYTES * TileStore::BYTES), tall ? 2 : 1);
             }
+            else
+            {
+                cacheKey = AssetCache::key(file.readAll(), QString("image;padding=%1;tall=%2;dither=%3;strength=%4")
+                    .arg(padding).arg(tall).arg(ditherModeBox->currentIndex()).arg(ditherStrengthSpinBox->value()));
+            }
+            file.close();
+        }
+
+        if(!cacheKey.isEmpty() && (suffix == "chr" || suffix == "png" || suffix == "gif" || suffix == "bmp") && cache.load(cacheKey, &cached))
+        {
+            image = cached.image;
+            if(suffix == "chr")
+            {
+                // Whichever tool stored the sheet, it's shown in this tool's grays.
+                for(int i = 0; i != 4; ++i)
+                {
+                    image.setColor(i, getPaletteColor(i));
+                }
+                file.open(QIODevice::ReadOnly);
+                chrData = file.read(file.size() / 16 * 16);
+                padding = false;
+                paddingOption->setChecked(false);
+            }
+            else
+            {
+                chrData.clear();
+            }
+            setupImage(filename, &cached);
+            loading = false;
+            return true;
+        }
+
+        if(suffix == "chr")
+        {
+            success = readCHR(filename);
         }
         else if(suffix == "png" || suffix == "gif" || suffix == "bmp")
         {
@@ -240,6 +542,12 @@ namespace chrbrew
         if(success)
         {
             setupImage(filename);
+            if(!cacheKey.isEmpty())
+            {
+                cached.image = image;
+                cached.conversions = conversions;
+                cache.store(cacheKey, cached);
+            }
         }
         loading = false;
 
@@ -262,124 +570,377 @@ namespace chrbrew
             return false;
         }
 
-        // Try to fit this in a nice rectangular region, so it's easier to view.
-        int columns = 0;
-        int rows = 0;
-        for(int i = 16; i != 1; i /= 2)
+        chrData = file.read(tiles * 16);
+        decodeCHR();
+
+        padding = false;
+        paddingOption->setChecked(false);
+
+        return true;
+    }
+
+    void EditorWidget::decodeCHR()
+    {
+        // Tall cells hold a tile pair: even tile on top, odd tile below.
+        int cellTiles = tall ? 2 : 1;
+        int columns;
+        int rows;
+        TileStore::sheetLayout(chrData.size() / TileStore::BYTES, cellTiles, &columns, &rows);
+
+        image = TileStore(chrData).renderIndexed(columns, rows, cellTiles);
+        for(int i = 0; i != 4; ++i)
+        {
+            image.setColor(i, getPaletteColor(i));
+        }
+    }
+
+    bool EditorWidget::readImage(const QString &filename)
+    {
+        chrData.clear();
+        QImage original(filename);
+        if(!original.isNull())
+        {
+            image = quantize(original);
+            return true;
+        }
+        QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' could not be imported as an image.").arg(filename));
+        return false;
+    }
+
+    bool EditorWidget::writeCHR(const QString& filename)
+    {
+        if(screen)
+        {
+            ScreenConverter converter;
+            converter.addImage(QFileInfo(filename).completeBaseName(), sourceTiles(), conversions);
+            return writeScreens(converter, filename, QFileInfo(filename).dir());
+        }
+
+        AtomicFile file(filename, patchOption->isChecked() ? AtomicFile::Patch : AtomicFile::Replace);
+        if(!file.open())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), file.errorString());
+            return false;
+        }
+
+        // Tall cells are written as their top tile, then their bottom tile.
+        auto type = compressionRLE->isChecked() ? Codec::RLE : compressionRuns->isChecked() ? Codec::Runs : Codec::None;
+        if(!Codec::compress(type, tiles.bytes(), &file))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), tr("The tiles use every byte value, so they can't be RLE packed."));
+            return false;
+        }
+        if(!file.finish())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), file.errorString());
+            return false;
+        }
+
+        // A reduced CHR only holds the surviving tiles; the map says which one each cell of the sheet uses.
+        // Both are written out before either replaces its target.
+        AtomicFile mapFile(TileReducer::mapFilename(filename), patchOption->isChecked() ? AtomicFile::Patch : AtomicFile::Replace);
+        if(!fitMap.isEmpty())
         {
-            if(tiles % i == 0)
+            if(!mapFile.open())
             {
-                if(i >= 8)
-                {
-                    columns = i;
-                    rows = tiles / i;
-                }
-                else
-                {
-                    rows = i;
-                    columns = tiles / i;
-                }
-                break;
+                QMessageBox::critical(this->parentWidget(), tr("Save Failed"), mapFile.errorString());
+                return false;
             }
+            mapFile.write(TileReducer::encodeMap(fitMap, tiles.count() / (tall ? 2 : 1)));
+            if(!mapFile.finish())
+            {
+                QMessageBox::critical(this->parentWidget(), tr("Save Failed"), mapFile.errorString());
+                return false;
+            }
+        }
+        if(!file.commit() || (!fitMap.isEmpty() && !mapFile.commit()))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), file.errorString().isEmpty() ? mapFile.errorString() : file.errorString());
+            return false;
         }
-        if(columns == 0)
+        return true;
+    }
+
+    bool EditorWidget::writeScreenBatch(const QStringList& filenames, const QString& directory)
+    {
+        if(image.isNull())
         {
-            columns = tiles;
-            rows = 1;
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), tr("Import one screen first. Its conversions are applied to every screen in the batch."));
+            return false;
         }
 
-        qDebug() << "tiles " << tiles << " rows " << rows << " columns " << columns;
+        ScreenConverter converter;
+        foreach(const QString& filename, filenames)
+        {
+            QImage source;
+            QList<int> sourceConversions;
+            if(!readBatchImage(filename, &source, &sourceConversions))
+            {
+                return false;
+            }
+            converter.addImage(QFileInfo(filename).completeBaseName(), source, sourceConversions);
+        }
 
-        image = QImage(columns * 8, rows * 8, QImage::Format_Indexed8);
-        image.setColorCount(4);
-        for(int i = 0; i != 4; ++i)
+        QDir dir(directory);
+        return writeScreens(converter, dir.filePath("screens.chr"), dir);
+    }
+
+    bool EditorWidget::readBatchImage(const QString& filename, QImage* source, QList<int>* sourceConversions)
+    {
+        *source = QImage(filename);
+        if(source->isNull())
         {
-            image.setColor(i, getPaletteColor(i));
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), tr("'%1' could not be imported as an image.").arg(filename));
+            return false;
         }
-        image.fill(0);
+        *source = source->convertToFormat(QImage::Format_RGB32, Qt::AvoidDither | Qt::ThresholdDither | Qt::ThresholdAlphaDither);
+        *source = source->convertToFormat(QImage::Format_Indexed8, Qt::AvoidDither | Qt::ThresholdDither | Qt::ThresholdAlphaDither);
 
-        QByteArray bytes(file.read(file.size()));
-        for(int r = 0; r != rows; ++r)
+        // Batch images share the loaded image's conversions, matched by color (or the nearest color).
+        auto reference = image.colorTable();
+        sourceConversions->clear();
+        foreach(QRgb color, source->colorTable())
         {
-            for(int c = 0; c != columns; ++c)
+            int best = 0;
+            int bestDistance = INT_MAX;
+            for(int i = 0, end = reference.count(); i != end && bestDistance != 0; ++i)
             {
-                for(int j = 0; j != 8; ++j)
+                int r = qRed(color) - qRed(reference[i]);
+                int g = qGreen(color) - qGreen(reference[i]);
+                int b = qBlue(color) - qBlue(reference[i]);
+                int distance = r * r + g * g + b * b;
+                if(distance < bestDistance)
                 {
-                    int index = ((r * columns + c) * 8 + j) * 2;
-                    unsigned char low = bytes[index];
-                    unsigned char high = bytes[index + 1];
-                    for(int i = 0; i != 8; ++i)
-                    {
-                        image.setPixel(
-                            c * 8 + i,
-                            r * 8 + j,
-                            ((high & (1 << (7 - i))) ? 2 : 0) | ((low & (1 << (7 - i))) ? 1 : 0)
-                        );
-                    }
+                    best = i;
+                    bestDistance = distance;
                 }
             }
+            sourceConversions->append(conversions[best]);
         }
+        return true;
+    }
 
-        padding = false;
-        paddingOption->setChecked(false);
+    bool EditorWidget::writeAnimation(const QStringList& filenames, const QString& filename)
+    {
+        if(image.isNull())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), tr("Import one frame first. Its conversions are applied to every frame."));
+            return false;
+        }
+
+        AnimationStreamer streamer(budgetSpinBox->value(), durationSpinBox->value());
+        foreach(const QString& sheetFilename, filenames)
+        {
+            QImage source;
+            QList<int> sourceConversions;
+            if(!readBatchImage(sheetFilename, &source, &sourceConversions))
+            {
+                return false;
+            }
+            streamer.addSheet(source, sourceConversions, frameHeightSpinBox->value());
+        }
+
+        auto result = streamer.stream();
+        if(!result.valid)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), result.error);
+            return false;
+        }
+
+        // The stream goes to the chosen file, and the first frame's tiles next to it.
+        QFileInfo info(filename);
+        QString chrFilename(info.dir().filePath(info.completeBaseName() + ".chr"));
+        QList<QPair<QString, QByteArray> > files;
+        files.append(qMakePair(filename, result.stream));
+        files.append(qMakePair(chrFilename, result.initial));
+        QString error;
+        if(!AtomicFile::writeFiles(files, &error))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), error);
+            return false;
+        }
 
+        animationLabel->setText(tr(
+                "%1 frame(s), %2 tile(s).<br>"
+                "Worst frame: #%3, %4 byte(s).<br>"
+                "Peak vblank: %5 / %6 byte(s).<br>"
+                "Longest delay: %7 vblank(s)."
+            )
+            .arg(result.frameBytes.count()).arg(result.tiles)
+            .arg(result.worstFrame).arg(result.worstFrameBytes)
+            .arg(result.peakVblankBytes).arg(budgetSpinBox->value())
+            .arg(result.maxDelay)
+        );
+        if(result.leftoverBytes)
+        {
+            QMessageBox::warning(this->parentWidget(), tr("Notice"),
+                tr("The animation doesn't keep up: %1 byte(s) are still queued when it loops. Raise the budget or the frame duration.").arg(result.leftoverBytes));
+        }
         return true;
     }
 
-    bool EditorWidget::readImage(const QString &filename)
+    bool EditorWidget::writeScreens(const ScreenConverter& converter, const QString& chrFilename, const QDir& dir)
     {
-        image = QImage(filename);
-        if(!image.isNull())
+        auto result = converter.convert();
+        if(!result.valid)
         {
-            image = image.convertToFormat(QImage::Format_RGB32, Qt::AvoidDither | Qt::ThresholdDither | Qt::ThresholdAlphaDither);
-            image = image.convertToFormat(QImage::Format_Indexed8, Qt::AvoidDither | Qt::ThresholdDither | Qt::ThresholdAlphaDither);
-            return true;
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), result.error);
+            return false;
         }
-        QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' could not be imported as an image.").arg(filename));
-        return false;
+
+        QList<QPair<QString, QByteArray> > files;
+        files.append(qMakePair(chrFilename, result.chr));
+
+        // Each screen's nametable is followed by its attribute table, as they sit in VRAM.
+        // A screen can use all 256 tiles, so compressed screens always use Runs, which needs no free byte value.
+        bool rle = !compressionNone->isChecked();
+        foreach(const ScreenConverter::Screen& screen, result.screens)
+        {
+            QByteArray bytes(screen.nametable + screen.attributes);
+            if(rle)
+            {
+                bool ok;
+                bytes = Codec::compress(Codec::Runs, bytes, &ok);
+            }
+
+            files.append(qMakePair(dir.filePath(screen.name + (rle ? ".rle" : ".nam")), bytes));
+        }
+
+        QString error;
+        if(!AtomicFile::writeFiles(files, &error))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), error);
+            return false;
+        }
+
+        tilesLabel->setText(tr("Output Tiles: %1").arg(result.chr.size() / ScreenConverter::TILE_BYTES));
+        if(result.mixedAreas)
+        {
+            QMessageBox::warning(this->parentWidget(), tr("Notice"), tr("%1 16x16 area(s) mix palettes. Each was given the highest palette it uses.").arg(result.mixedAreas));
+        }
+        return true;
     }
 
-    bool EditorWidget::writeCHR(const QString& filename)
+    bool EditorWidget::writeROM(const QString& filename, int startBank, const QString& ipsFilename, QString* summary)
     {
-        QFile file(filename);
-        if(!file.open(QIODevice::WriteOnly))
+        if(tiles.isEmpty())
         {
-            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), tr("Failed to open '%1' for writing").arg(filename));
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), tr("There are no tiles to write into the ROM."));
             return false;
         }
 
-        if(compressionRLE->isChecked())
+        // ROMs hold raw tiles, so the output compression doesn't apply here.
+        auto result = RomPatcher(filename).patch(tiles.bytes(), startBank, ipsFilename);
+        if(!result.valid)
         {
-            QMessageBox::warning(this->parentWidget(), tr("Notice"), tr("RLE isn't implemented yet. Saving without compression."));
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), result.error);
+            return false;
+        }
+        *summary = tr("%1 of %2 bank(s) changed in %3.").arg(result.changedBanks).arg(result.writtenBanks).arg(QFileInfo(filename).fileName());
+        return true;
+    }
+
+    bool EditorWidget::writeMetatiles(const QString& filename)
+    {
+        if(image.isNull())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), tr("There is no image to build metatiles from."));
+            return false;
+        }
+
+        auto result = MetatileBuilder(sourceTiles(), conversions).build();
+        if(!result.valid)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), result.error);
+            return false;
+        }
+        int tiles = result.chr.size() / MetatileBuilder::TILE_BYTES;
+        if(tiles > 256)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), tr("The metatiles use %1 unique tiles, but a table entry can only index 256.").arg(tiles));
+            return false;
         }
 
+        // The character set goes next to the table, so the source CHR is never overwritten.
+        QFileInfo info(filename);
+        QString chrFilename(info.dir().filePath(info.completeBaseName() + "_tiles.chr"));
+
+        // One array per corner, then the palettes, each with an entry per metatile.
         QByteArray bytes;
-        for(int y = 0, h = preview.height(); y != h; y += 8)
+        const QVector<int>* arrays[] = { &result.topLeft, &result.topRight, &result.bottomLeft, &result.bottomRight, &result.palettes };
+        for(int i = 0; i != 5; ++i)
         {
-            for(int x = 0, w = preview.width(); x != w; x += 8)
+            foreach(int value, *arrays[i])
             {
-                for(int j = 0; j != 8; ++j)
-                {
-                    unsigned char low = 0;
-                    unsigned char high = 0;
-                    for(int i = 0; i != 8; ++i)
-                    {
-                        unsigned int color = conversions[preview.pixelIndex(x + i, y + j)];
-                        low = (low << 1) | (color & 0x1);
-                        high = (high << 1) | ((color & 0x2) >> 1);
-                    }
-                    bytes.append(low);
-                    bytes.append(high);
-                }
+                bytes.append(char(value));
             }
         }
-        file.write(bytes);
-        file.close();
+        QList<QPair<QString, QByteArray> > files;
+        files.append(qMakePair(filename, bytes));
+        files.append(qMakePair(chrFilename, result.chr));
+        QString error;
+        if(!AtomicFile::writeFiles(files, &error))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), error);
+            return false;
+        }
+
+        metatilesLabel->setText(tr("Metatiles: %1 (%2 tiles)").arg(result.palettes.count()).arg(tiles));
+        if(result.mixedBlocks)
+        {
+            QMessageBox::warning(this->parentWidget(), tr("Notice"), tr("%1 block(s) mix palettes. Each was given the highest palette it uses.").arg(result.mixedBlocks));
+        }
         return true;
     }
 
-    void EditorWidget::setupImage(const QString& filename)
+    bool EditorWidget::writeMap(const QString& mapFilename, const QString& filename, QString* summary)
     {
+        if(image.isNull())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("Open the map's tileset image first, so its metatiles can be matched."));
+            return false;
+        }
+
+        // Built the same way as Export Metatiles, so the map indexes the same metatile tables.
+        auto metatiles = MetatileBuilder(sourceTiles(), conversions).build();
+        if(!metatiles.valid)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), metatiles.error);
+            return false;
+        }
+
+        auto result = MapImporter(metatiles.map, metatiles.columns).import(mapFilename);
+        if(!result.valid)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), result.error);
+            return false;
+        }
+
+        AtomicFile file(filename);
+        if(!file.open())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), file.errorString());
+            return false;
+        }
+        file.write(result.data);
+        if(!file.commit())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), file.errorString());
+            return false;
+        }
+
+        *summary = tr("%1x%2 map packed into %3 screen(s): %4 byte(s), was %5.")
+            .arg(result.width)
+            .arg(result.height)
+            .arg(result.screensWide * result.screensHigh)
+            .arg(result.data.size())
+            .arg(result.rawBytes);
+        return true;
+    }
+
+    void EditorWidget::setupImage(const QString& filename, const AssetCache::Entry* cached)
+    {
+        imageFilename = filename;
         sourceColorsLabel->setText(tr("Source Colors: %1").arg(image.colorCount()));
         imageFilenameLabel->setText(tr("<b>%1</b>").arg(QFileInfo(filename).fileName()));
         imageLabel->setPixmap(QPixmap::fromImage(image));
@@ -435,7 +996,19 @@ namespace chrbrew
             conversions.append(0);
         }
 
-        autoFillConversions();
+        if(cached && cached->conversions.count() == conversions.count())
+        {
+            for(int i = 0, end = conversions.count(); i != end; ++i)
+            {
+                auto edit = qobject_cast<QLineEdit*>(conversionFields->itemAt(i)->widget());
+                edit->setText(tr("%1").arg(cached->conversions[i]));
+                conversions[i] = cached->conversions[i];
+            }
+        }
+        else
+        {
+            autoFillConversions();
+        }
         calculatePalette();
         calculatePreview();
     }
@@ -454,59 +1027,12 @@ namespace chrbrew
 
     void EditorWidget::autoFillConversions()
     {
-        // Remove padding color.
-        auto palette = orderedPalette(image);
-        if(padding && image.width() && image.height())
-        {
-            int colorIndex = image.pixelIndex(0, 0);
-            auto edit = qobject_cast<QLineEdit*>(conversionFields->itemAt(colorIndex)->widget());
-            edit->setText(tr("%1").arg(0));
-            palette.remove(palette.indexOf(colorIndex));
-            conversions[colorIndex] = 0;
-        }
-
-        // Remove 'transparent' color (fully-saturated colors).
-        auto it = palette.begin();
-        while(it != palette.end())
-        {
-            int colorIndex = *it;
-            QRgb color = image.color(colorIndex);
-            int r = qRed(color);
-            int g = qGreen(color);
-            int b = qBlue(color);
-            if((r == 0x00 || r == 0xFF)
-                && (g == 0x00 || g == 0xFF)
-                && (b == 0x00 || b == 0xFF)
-                && !(r == 0x00 && g == 0x00 && b == 0x00)
-                && !(r == 0xFF && g == 0xFF && b == 0xFF))
-            {
-                it = palette.erase(it);
-                auto edit = qobject_cast<QLineEdit*>(conversionFields->itemAt(colorIndex)->widget());
-                edit->setText(tr("%1").arg(0));
-                conversions[colorIndex] = 0;
-            }
-            else
-            {
-                ++it;
-            }
-        }
-
-        for(int i = 0, end = palette.count(); i != end; ++i)
+        auto automatic = Converter::automaticConversions(image, padding);
+        for(int i = 0, end = conversions.count(); i != end; ++i)
         {
-            int conversion = i * 4 / end;
-            int colorIndex = palette[i];
-
-            auto edit = qobject_cast<QLineEdit*>(conversionFields->itemAt(colorIndex)->widget());
-            edit->setText(tr("%1").arg(conversion));
-            conversions[colorIndex] = conversion;
-        }
-
-        if(palette.count())
-        {
-            int colorIndex = palette[palette.count() - 1];
-            auto edit = qobject_cast<QLineEdit*>(conversionFields->itemAt(colorIndex)->widget());
-            edit->setText(tr("%1").arg(3));
-            conversions[colorIndex] = 3;
+            auto edit = qobject_cast<QLineEdit*>(conversionFields->itemAt(i)->widget());
+            edit->setText(tr("%1").arg(automatic[i]));
+            conversions[i] = automatic[i];
         }
     }
 
@@ -524,14 +1050,14 @@ namespace chrbrew
                     index = 0;
                     edit->setText(tr("%1").arg(index));
                 }
-                else if(index > 3)
+                else if(index > 15)
                 {
-                    index = 3;
+                    index = 15;
                     edit->setText(tr("%1").arg(index));
                 }
                 conversions[i] = index;
                 QLabel* label(qobject_cast<QLabel*>(destPalette->itemAt(i)->widget()));
-                label->setPalette(QPalette(QColor(getPaletteColor(index))));
+                label->setPalette(QPalette(QColor(getPaletteColor(index & 0x3))));
             }
         }
     }
@@ -540,27 +1066,87 @@ namespace chrbrew
     {
         if(!image.isNull())
         {
-            if(padding)
+            // Tiles are encoded straight from the source, so the preview is just a view of the output.
+            int cellHeight = tall ? TILE_HEIGHT * 2 : TILE_HEIGHT;
+            int border = padding ? 1 : 0;
+            int columns = image.width() / (TILE_WIDTH + border);
+            int rows = image.height() / (cellHeight + border);
+            tiles = TileStore(TileEncoder::encodeImage(image, TileEncoder::lookup(conversions), cellHeight, border));
+
+            QRgb colors[4];
+            for(int i = 0; i != 4; ++i)
             {
-                preview = stripPadding(image);
+                colors[i] = getPaletteColor(i);
             }
-            else
+
+            QImage sheet;
+            if(fitOption->isChecked())
             {
-                preview = image.copy(0, 0, image.width() / TILE_WIDTH * TILE_WIDTH, image.height() / TILE_HEIGHT * TILE_HEIGHT);
+                // The output becomes the surviving tiles; the preview shows the sheet rebuilt from them.
+                int cellTiles = cellHeight / TILE_HEIGHT;
+                auto result = TileReducer(tiles.bytes(), cellHeight * 2).reduce(fitSpinBox->value() / cellTiles);
+                tiles = TileStore(result.chr);
+                fitMap = result.map;
+                sheet = TileStore(result.sheet).render(columns, rows, cellTiles, colors);
+
+                QPainter painter(&sheet);
+                painter.setPen(Qt::red);
+                int changed = 0;
+                for(int c = 0, end = result.changed.count(); c != end; ++c)
+                {
+                    if(result.changed[c])
+                    {
+                        painter.drawRect(c % columns * TILE_WIDTH, c / columns * cellHeight, TILE_WIDTH - 1, cellHeight - 1);
+                        ++changed;
+                    }
+                }
+                fitLabel->setText(tr("%1 tile(s) merged, %2 cell(s) changed, difference %3.")
+                    .arg(result.mergedUnits * cellTiles)
+                    .arg(changed)
+                    .arg(result.totalDistance));
             }
-            for(int i = 0, end = conversions.count(); i != end; ++i)
+            else
             {
-                preview.setColor(i, getPaletteColor(conversions[i]));
+                sheet = tiles.render(columns, rows, cellHeight / TILE_HEIGHT, colors);
+                fitMap.clear();
+                fitLabel->clear();
             }
 
+            measureButton->setEnabled(true);
             previewImageLabel->setText(tr(""));
-            previewImageLabel->setPixmap(QPixmap::fromImage(preview));
+            previewImageLabel->setPixmap(QPixmap::fromImage(sheet));
 
             paletteHelpLabel->show();
             previewHelpLabel->show();
 
-            int tiles = (preview.width() / TILE_WIDTH) * (preview.height() / TILE_HEIGHT);
-            tilesLabel->setText(tr("Output Tiles: %1").arg(tiles));
+            tilesLabel->setText(tr("Output Tiles: %1").arg(tiles.count()));
+            if(shareOption->isChecked())
+            {
+                sharedCHR.publish(tiles.bytes());
+            }
+        }
+        updateMemory();
+    }
+
+    void EditorWidget::updateMemory()
+    {
+        MemoryTracker::set("chrbrew: source image", MemoryTracker::bytes(image));
+        MemoryTracker::set("chrbrew: imported CHR", MemoryTracker::bytes(chrData));
+        MemoryTracker::set("chrbrew: output tiles", MemoryTracker::bytes(tiles.bytes()));
+        MemoryTracker::set("chrbrew: source pixmap", MemoryTracker::bytes(imageLabel->pixmap()));
+        MemoryTracker::set("chrbrew: preview pixmap", MemoryTracker::bytes(previewImageLabel->pixmap()));
+        MemoryTracker::set("chrbrew: palette widgets",
+            qint64(sourcePalette->count() + destPalette->count() + conversionFields->count()) * MemoryTracker::WIDGET_BYTES);
+    }
+
+    QImage EditorWidget::sourceTiles() const
+    {
+        // Exporters that need the palette bits of each conversion work from the unpadded source indices.
+        int cellHeight = tall ? TILE_HEIGHT * 2 : TILE_HEIGHT;
+        if(padding)
+        {
+            return stripPadding(image, cellHeight);
         }
+        return image.copy(0, 0, image.width() / TILE_WIDTH * TILE_WIDTH, image.height() / cellHeight * cellHeight);
     }
 }
@@ -2,9 +2,19 @@
 #define EDITORWIDGET_H
 
 #include <QtGui>
+#include "assetcache.h"
+#include "codec.h"
+#include "sharedchr.h"
+#include "tilestore.h"
 
 namespace chrbrew
 {
+    using overbrew::AssetCache;
+    using overbrew::SharedCHR;
+    using overbrew::TileStore;
+
+    class ScreenConverter;
+
     class EditorWidget : public QWidget
     {
         Q_OBJECT
@@ -12,15 +22,21 @@ namespace chrbrew
             static const int TILE_WIDTH = 8;
             static const int TILE_HEIGHT = 8;
 
-            static QVector<int> orderedPalette(const QImage& source);
-            static QImage stripPadding(const QImage& source);
+            static QImage stripPadding(const QImage& source, int cellHeight);
 
         public:
             EditorWidget();
+            ~EditorWidget();
 
         private slots:
             void browse();
             void toggledPadding(bool checked);
+            void toggledTall(bool checked);
+            void toggledScreen(bool checked);
+            void toggledShare(bool checked);
+            void measureCompression();
+            void fitChanged();
+            void ditherChanged();
             void conversionChanged(const QString& text);
 
         public:
@@ -28,24 +44,53 @@ namespace chrbrew
             bool readCHR(const QString& filename);
             bool readImage(const QString& filename);
             bool writeCHR(const QString& filename);
+            bool writeMetatiles(const QString& filename);
+            bool writeMap(const QString& mapFilename, const QString& filename, QString* summary);
+            bool writeROM(const QString& filename, int startBank, const QString& ipsFilename, QString* summary);
+            bool writeScreenBatch(const QStringList& filenames, const QString& directory);
+            bool writeAnimation(const QStringList& filenames, const QString& filename);
 
         private:
-            void setupImage(const QString& filename);
+            void decodeCHR();
+            bool readBatchImage(const QString& filename, QImage* source, QList<int>* sourceConversions);
+            bool writeScreens(const ScreenConverter& converter, const QString& chrFilename, const QDir& dir);
+            void setupImage(const QString& filename, const AssetCache::Entry* cached = 0);
             QRgb getPaletteColor(int i);
             void autoFillConversions();
             void calculatePalette();
             void calculatePreview();
+            void updateMemory();
+            void requantize();
+            QImage quantize(const QImage& source) const;
+            QImage sourceTiles() const;
 
             QPushButton* imageBrowseButton;
             QRadioButton* compressionNone;
             QRadioButton* compressionRLE;
+            QRadioButton* compressionRuns;
+            QLabel* compressionCostLabels[Codec::TypeCount];
+            QPushButton* measureButton;
+            QCheckBox* patchOption;
+            QCheckBox* fitOption;
+            QSpinBox* fitSpinBox;
+            QComboBox* ditherModeBox;
+            QSpinBox* ditherStrengthSpinBox;
             QCheckBox* paddingOption;
+            QCheckBox* tallOption;
+            QCheckBox* screenOption;
+            QCheckBox* shareOption;
+            QSpinBox* budgetSpinBox;
+            QSpinBox* durationSpinBox;
+            QSpinBox* frameHeightSpinBox;
 
             QLabel* imageFilenameLabel;
             QLabel* sourceColorsLabel;
             QLabel* tileCountLabel;
             QLabel* paletteHelpLabel;
             QLabel* tilesLabel;
+            QLabel* metatilesLabel;
+            QLabel* fitLabel;
+            QLabel* animationLabel;
             QLabel* previewHelpLabel;
 
             QLabel* imageLabel;
@@ -57,9 +102,16 @@ namespace chrbrew
             QList<int> conversions;
 
             bool padding;
+            bool tall;
+            bool screen;
+            QByteArray chrData;
+            QString imageFilename;
             QImage image;
-            QImage preview;
+            TileStore tiles;
+            QVector<int> fitMap;
+            SharedCHR sharedCHR;
             bool loading;
+            AssetCache cache;
     };
 }
 
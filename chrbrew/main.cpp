@@ -2,9 +2,116 @@
 #include <QTextEdit>
 
 #include "mainwindow.h"
+#include "codec.h"
+#include "conversionserver.h"
+#include "memorytracker.h"
+
+namespace
+{
+    // chrbrew --measure file.chr [--memory]: prints each codec's size and 6502 decode time, without a window.
+    int measure(const QString& filename, bool memory)
+    {
+        QTextStream out(stdout);
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            out << QObject::tr("'%1' could not be opened.").arg(filename) << endl;
+            return 1;
+        }
+
+        auto chr = file.readAll();
+        overbrew::MemoryTracker::set("measure: CHR", overbrew::MemoryTracker::bytes(chr));
+        int result = 0;
+        for(int i = 0; i != chrbrew::Codec::TypeCount; ++i)
+        {
+            auto type = chrbrew::Codec::Type(i);
+            auto cost = chrbrew::Codec::measure(type, chr);
+            if(cost.valid)
+            {
+                out << QString("%1: %2 bytes, %3 cycles, %4 cycles/tile, %5 cycles/bank (worst)")
+                    .arg(chrbrew::Codec::name(type))
+                    .arg(cost.size)
+                    .arg(cost.cycles)
+                    .arg(cost.tiles ? cost.cycles / cost.tiles : 0)
+                    .arg(cost.worstBankCycles) << endl;
+            }
+            else
+            {
+                out << chrbrew::Codec::name(type) << ": " << cost.error << endl;
+                result = 1;
+            }
+        }
+        if(memory)
+        {
+            out << overbrew::MemoryTracker::report();
+        }
+        return result;
+    }
+
+    int report(const chrbrew::ConversionServer::Reply& reply)
+    {
+        QTextStream(reply.status ? stderr : stdout) << reply.report;
+        return reply.status;
+    }
+}
 
 int main(int argc, char** argv)
 {
+    if((argc == 3 || (argc == 4 && QString(argv[3]) == "--memory")) && QString(argv[1]) == "--measure")
+    {
+        QCoreApplication app(argc, argv);
+        return measure(QString::fromLocal8Bit(argv[2]), argc == 4);
+    }
+
+    // chrbrew --convert [options] input output ...: converts in this process.
+    // chrbrew --client [options] input output ...: hands the same job to a running daemon, or converts here if none is up.
+    // chrbrew --daemon [--cache-mb N]: serves conversions until killed, keeping up to N MB of decoded images between requests.
+    // Add --memory to a conversion (or send it alone with --client) to report tracked buffer sizes.
+    if(argc >= 2 && (QString(argv[1]) == "--convert" || QString(argv[1]) == "--client" || QString(argv[1]) == "--daemon"))
+    {
+        QCoreApplication app(argc, argv);
+        auto arguments = app.arguments().mid(2);
+        auto mode = app.arguments()[1];
+
+        if(mode == "--daemon")
+        {
+            qint64 cacheLimit = chrbrew::Converter::DEFAULT_CACHE_LIMIT;
+            if(arguments.count() == 2 && arguments[0] == "--cache-mb")
+            {
+                bool ok;
+                int megabytes = arguments[1].toInt(&ok);
+                if(!ok || megabytes < 0)
+                {
+                    QTextStream(stderr) << QObject::tr("'%1' is not a cache size in megabytes.").arg(arguments[1]) << endl;
+                    return 1;
+                }
+                cacheLimit = qint64(megabytes) * 1024 * 1024;
+            }
+            else if(!arguments.isEmpty())
+            {
+                QTextStream(stderr) << QObject::tr("Usage: chrbrew --daemon [--cache-mb N]") << endl;
+                return 1;
+            }
+
+            chrbrew::ConversionServer server(cacheLimit);
+            QString error;
+            if(!server.listen(&error))
+            {
+                QTextStream(stderr) << error << endl;
+                return 1;
+            }
+            return app.exec();
+        }
+
+        chrbrew::ConversionServer::Reply reply;
+        if(mode == "--client" && chrbrew::ConversionServer::request(arguments, &reply))
+        {
+            return report(reply);
+        }
+        chrbrew::Converter converter;
+        return report(chrbrew::ConversionServer::execute(&converter, arguments));
+    }
+
     QApplication app(argc, argv);
     app.setOrganizationName("Overkill");
     app.setApplicationName(chrbrew::AppName);
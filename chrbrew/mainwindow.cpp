@@ -1,10 +1,12 @@
 #include <QMessageBox>
 
 #include "mainwindow.h"
+#include "memorytracker.h"
 
 namespace chrbrew
 {
     MainWindow::MainWindow()
+        : memoryDialog(0)
     {
         resize(640, 640);
 
@@ -37,6 +39,11 @@ namespace chrbrew
         createSeparator(fileMenu);
         saveAction = createAction(fileMenu, tr("&Save..."), tr("Save the current CHR."), QKeySequence::Save);
         saveAsAction = createAction(fileMenu, tr("Save &As..."), tr("Save a copy of the current CHR."), QKeySequence::SaveAs);
+        exportMetatilesAction = createAction(fileMenu, tr("Export &Metatiles..."), tr("Save 2x2 metatile tables and their CHR."), QKeySequence(Qt::CTRL + Qt::Key_M));
+        exportROMAction = createAction(fileMenu, tr("Patch &ROM..."), tr("Write the CHR into the CHR-ROM of an existing iNES image."), QKeySequence(Qt::CTRL + Qt::Key_P));
+        importMapAction = createAction(fileMenu, tr("Import &Tiled Map..."), tr("Pack a Tiled map of this image's metatiles into screens."), QKeySequence(Qt::CTRL + Qt::Key_T));
+        exportScreenBatchAction = createAction(fileMenu, tr("Convert Screen &Batch..."), tr("Convert many screens into nametables sharing one CHR."), QKeySequence(Qt::CTRL + Qt::Key_B));
+        exportAnimationAction = createAction(fileMenu, tr("Convert &Animation..."), tr("Convert animation frames into a CHR-RAM update stream."), QKeySequence(Qt::CTRL + Qt::Key_R));
         createSeparator(fileMenu);
         for(int i = 0; i < MaxRecentCount; ++i)
         {
@@ -50,6 +57,9 @@ namespace chrbrew
         createSeparator(fileMenu);
         exitAction = createAction(fileMenu, tr("E&xit"), tr("Exit the program."), quitSequence);
 
+        debugMenu = menuBar()->addMenu(tr("&Debug"));
+        memoryAction = createAction(debugMenu, tr("&Memory Usage..."), tr("Show the bytes held by images, pixmaps, caches and widgets."), QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_M));
+
         helpMenu = menuBar()->addMenu(tr("&Help"));
         aboutAction = createAction(helpMenu, tr("&About..."), tr("About %1.").arg(AppName), QKeySequence::HelpContents);
 
@@ -57,8 +67,14 @@ namespace chrbrew
         connect(openAction, SIGNAL(triggered()), this, SLOT(openFile()));
         connect(saveAction, SIGNAL(triggered()), this, SLOT(saveFile()));
         connect(saveAsAction, SIGNAL(triggered()), this, SLOT(saveFileAs()));
+        connect(exportMetatilesAction, SIGNAL(triggered()), this, SLOT(exportMetatiles()));
+        connect(exportROMAction, SIGNAL(triggered()), this, SLOT(exportROM()));
+        connect(importMapAction, SIGNAL(triggered()), this, SLOT(importMap()));
+        connect(exportScreenBatchAction, SIGNAL(triggered()), this, SLOT(exportScreenBatch()));
+        connect(exportAnimationAction, SIGNAL(triggered()), this, SLOT(exportAnimation()));
         connect(clearRecentAction, SIGNAL(triggered()), this, SLOT(clearRecentFiles()));
         connect(exitAction, SIGNAL(triggered()), this, SLOT(close()));
+        connect(memoryAction, SIGNAL(triggered()), this, SLOT(showMemory()));
         connect(aboutAction, SIGNAL(triggered()), this, SLOT(about()));
 
         QTimer::singleShot(0, this, SLOT(newFile()));
@@ -112,6 +128,133 @@ namespace chrbrew
         }
     }
 
+    void MainWindow::exportMetatiles()
+    {
+        auto filename = QFileDialog::getSaveFileName(
+            this,
+            tr("Export Metatiles"),
+            QString(),
+            tr("Metatile Tables (*.bin);;")
+        );
+        if(!filename.isEmpty() && editor->writeMetatiles(filename))
+        {
+            statusBar()->showMessage(tr("Metatiles exported as %1.").arg(filename), 2000);
+        }
+    }
+
+    void MainWindow::exportROM()
+    {
+        auto filename = QFileDialog::getOpenFileName(
+            this,
+            tr("Patch ROM"),
+            QString(),
+            tr("iNES ROMs (*.nes);;")
+        );
+        if(filename.isEmpty())
+        {
+            return;
+        }
+
+        bool ok;
+        int startBank = QInputDialog::getInt(this, tr("Patch ROM"), tr("First 1 KB CHR bank to overwrite:"), 0, 0, 0x7FFF, 1, &ok);
+        if(!ok)
+        {
+            return;
+        }
+
+        QString ipsFilename;
+        if(QMessageBox::question(this, tr("Patch ROM"), tr("Also save the changes as an IPS patch?"),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::No) == QMessageBox::Yes)
+        {
+            QFileInfo info(filename);
+            ipsFilename = QFileDialog::getSaveFileName(
+                this,
+                tr("Save IPS Patch"),
+                info.dir().filePath(info.completeBaseName() + ".ips"),
+                tr("IPS Patches (*.ips);;")
+            );
+            if(ipsFilename.isEmpty())
+            {
+                return;
+            }
+        }
+
+        QString summary;
+        if(editor->writeROM(filename, startBank, ipsFilename, &summary))
+        {
+            statusBar()->showMessage(summary, 2000);
+        }
+    }
+
+    void MainWindow::importMap()
+    {
+        auto mapFilename = QFileDialog::getOpenFileName(
+            this,
+            tr("Import Tiled Map"),
+            QString(),
+            tr("Tiled Maps (*.tmx *.csv);;")
+        );
+        if(mapFilename.isEmpty())
+        {
+            return;
+        }
+        QFileInfo info(mapFilename);
+        auto filename = QFileDialog::getSaveFileName(
+            this,
+            tr("Save Map"),
+            info.dir().filePath(info.completeBaseName() + "_map.bin"),
+            tr("Screen Maps (*.bin);;")
+        );
+        QString summary;
+        if(!filename.isEmpty() && editor->writeMap(mapFilename, filename, &summary))
+        {
+            statusBar()->showMessage(summary, 2000);
+        }
+    }
+
+    void MainWindow::exportScreenBatch()
+    {
+        auto filenames = QFileDialog::getOpenFileNames(
+            this,
+            tr("Convert Screen Batch"),
+            QString(),
+            tr("Images (*.png *.gif *.bmp);;")
+        );
+        if(filenames.isEmpty())
+        {
+            return;
+        }
+        auto directory = QFileDialog::getExistingDirectory(this, tr("Output Directory"));
+        if(!directory.isEmpty() && editor->writeScreenBatch(filenames, directory))
+        {
+            statusBar()->showMessage(tr("%1 screen image(s) converted into %2.").arg(filenames.count()).arg(directory), 2000);
+        }
+    }
+
+    void MainWindow::exportAnimation()
+    {
+        auto filenames = QFileDialog::getOpenFileNames(
+            this,
+            tr("Convert Animation Frames"),
+            QString(),
+            tr("Images (*.png *.gif *.bmp);;")
+        );
+        if(filenames.isEmpty())
+        {
+            return;
+        }
+        auto filename = QFileDialog::getSaveFileName(
+            this,
+            tr("Save Animation Stream"),
+            QString(),
+            tr("CHR-RAM Streams (*.bin);;")
+        );
+        if(!filename.isEmpty() && editor->writeAnimation(filenames, filename))
+        {
+            statusBar()->showMessage(tr("Animation stream saved as %1.").arg(filename), 2000);
+        }
+    }
+
     void MainWindow::openRecentFile()
     {
         auto action = qobject_cast<QAction*>(sender());
@@ -130,6 +273,56 @@ namespace chrbrew
         updateRecentFiles();
     }
 
+    void MainWindow::showMemory()
+    {
+        if(!memoryDialog)
+        {
+            memoryDialog = new QDialog(this);
+            memoryDialog->setWindowTitle(tr("Memory Usage"));
+            memoryDialog->resize(400, 300);
+
+            auto layout = new QVBoxLayout();
+            memoryDialog->setLayout(layout);
+
+            memoryTable = new QTableWidget(0, 2);
+            memoryTable->setHorizontalHeaderLabels(QStringList() << tr("Buffer") << tr("KB"));
+            memoryTable->horizontalHeader()->setStretchLastSection(true);
+            memoryTable->verticalHeader()->hide();
+            memoryTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+            layout->addWidget(memoryTable);
+
+            memoryTotalLabel = new QLabel();
+            layout->addWidget(memoryTotalLabel);
+
+            auto buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+            auto refreshButton = buttons->addButton(tr("&Refresh"), QDialogButtonBox::ActionRole);
+            layout->addWidget(buttons);
+
+            connect(refreshButton, SIGNAL(clicked()), this, SLOT(refreshMemory()));
+            connect(buttons, SIGNAL(rejected()), memoryDialog, SLOT(hide()));
+        }
+        refreshMemory();
+        memoryDialog->show();
+        memoryDialog->raise();
+    }
+
+    void MainWindow::refreshMemory()
+    {
+        auto entries = overbrew::MemoryTracker::entries();
+        memoryTable->setRowCount(entries.count());
+        qint64 total = 0;
+        for(int i = 0, end = entries.count(); i != end; ++i)
+        {
+            memoryTable->setItem(i, 0, new QTableWidgetItem(entries[i].first));
+            auto size = new QTableWidgetItem(QString::number((entries[i].second + 1023) / 1024));
+            size->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            memoryTable->setItem(i, 1, size);
+            total += entries[i].second;
+        }
+        memoryTable->resizeColumnToContents(0);
+        memoryTotalLabel->setText(tr("Total tracked: %1 KB").arg((total + 1023) / 1024));
+    }
+
     void MainWindow::about()
     {
         QMessageBox::about(this, tr("%1").arg(AppName), tr(
@@ -22,8 +22,15 @@ namespace chrbrew
             void openFile();
             void saveFile();
             void saveFileAs();
+            void exportMetatiles();
+            void exportROM();
+            void importMap();
+            void exportScreenBatch();
+            void exportAnimation();
             void openRecentFile();
             void clearRecentFiles();
+            void showMemory();
+            void refreshMemory();
             void about();
 
         private:
@@ -36,20 +43,31 @@ namespace chrbrew
             void updateRecentFiles();
 
             QMenu* fileMenu;
+            QMenu* debugMenu;
             QMenu* helpMenu;
             QAction* newAction;
             QAction* openAction;
             QAction* saveAsAction;
             QAction* saveAction;
+            QAction* exportMetatilesAction;
+            QAction* exportROMAction;
+            QAction* importMapAction;
+            QAction* exportScreenBatchAction;
+            QAction* exportAnimationAction;
             QAction* recentFileActions[MaxRecentCount];
             QAction* clearRecentAction;
             QAction* exitAction;
+            QAction* memoryAction;
             QAction* aboutAction;
 
             QString currentFile;
 
             QScrollArea* scroll;
             EditorWidget* editor;
+
+            QDialog* memoryDialog;
+            QTableWidget* memoryTable;
+            QLabel* memoryTotalLabel;
     };
 }
 
@@ -0,0 +1,475 @@
+#include <cstring>
+
+#include "mapimporter.h"
+#include "codec.h"
+
+namespace chrbrew
+{
+    namespace
+    {
+        const quint32 FLIP_FLAGS = 0xE0000000;
+        const int MAX_OFFSET = 0xFFFF;
+        const int READ_BYTES = 16 * 1024;
+        const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        inline ushort code(char c)
+        {
+            return uchar(c);
+        }
+
+        inline ushort code(QChar c)
+        {
+            return c.unicode();
+        }
+
+        // Splits comma/newline separated numbers out of text that arrives in pieces,
+        // counting the values on the first line to learn the width.
+        struct NumberStream
+        {
+            QVector<quint32>* values;
+            quint32 value;
+            bool digits;
+            bool negative;
+            int width;
+
+            explicit NumberStream(QVector<quint32>* values)
+                : values(values), value(0), digits(false), negative(false), width(0)
+            {
+            }
+
+            template<typename Char> bool feed(const Char* text, int size)
+            {
+                for(int i = 0; i != size; ++i)
+                {
+                    ushort c = code(text[i]);
+                    if(c >= '0' && c <= '9')
+                    {
+                        value = value * 10 + (c - '0');
+                        digits = true;
+                    }
+                    else if(c == ',' || c == '\n' || c == '\r' || c == ' ' || c == '\t')
+                    {
+                        finish();
+                        if(c == '\n' && !width)
+                        {
+                            width = values->count();
+                        }
+                    }
+                    else if(c == '-')
+                    {
+                        negative = true;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void finish()
+            {
+                // Tiled's CSV export writes -1 for empty cells, which becomes gid 0 once ids are offset.
+                if(digits)
+                {
+                    values->append(negative ? quint32(-1) : value);
+                    value = 0;
+                    digits = false;
+                }
+                negative = false;
+            }
+        };
+
+        // Decodes Base64 text that arrives in pieces, skipping whitespace and stopping at the '=' padding.
+        struct Base64Stream
+        {
+            quint32 bits;
+            int count;
+            bool ended;
+
+            Base64Stream()
+                : bits(0), count(0), ended(false)
+            {
+            }
+
+            template<typename Char> bool feed(const Char* text, int size, QByteArray* out)
+            {
+                for(int i = 0; i != size && !ended; ++i)
+                {
+                    ushort c = code(text[i]);
+                    if(c == ' ' || c == '\n' || c == '\r' || c == '\t')
+                    {
+                        continue;
+                    }
+                    if(c == '=')
+                    {
+                        finish(out);
+                        continue;
+                    }
+                    auto found = c && c < 128 ? std::strchr(BASE64, c) : 0;
+                    if(!found)
+                    {
+                        return false;
+                    }
+
+                    bits = bits << 6 | quint32(found - BASE64);
+                    if(++count == 4)
+                    {
+                        out->append(char(bits >> 16));
+                        out->append(char(bits >> 8));
+                        out->append(char(bits));
+                        bits = 0;
+                        count = 0;
+                    }
+                }
+                return true;
+            }
+
+            void finish(QByteArray* out)
+            {
+                if(!ended)
+                {
+                    if(count == 2)
+                    {
+                        out->append(char(bits >> 4));
+                    }
+                    else if(count == 3)
+                    {
+                        out->append(char(bits >> 10));
+                        out->append(char(bits >> 2));
+                    }
+                    ended = true;
+                }
+            }
+        };
+
+        // Takes whole little-endian gids from the bytes, leaving a partial one in pending.
+        void appendGids(QByteArray* pending, const QByteArray& bytes, QVector<quint32>* gids)
+        {
+            pending->append(bytes);
+            auto data = reinterpret_cast<const uchar*>(pending->constData());
+            int whole = pending->size() / 4;
+            for(int i = 0; i != whole; ++i)
+            {
+                gids->append(data[i * 4] | (data[i * 4 + 1] << 8) | (data[i * 4 + 2] << 16) | (quint32(data[i * 4 + 3]) << 24));
+            }
+            pending->remove(0, whole * 4);
+        }
+    }
+
+    struct MapImporter::Layer
+    {
+        int width;
+        int height;
+        int firstGid;
+        QVector<quint32> gids;
+    };
+
+    MapImporter::MapImporter(const QVector<int>& blockMetatiles, int tilesetColumns)
+        : blockMetatiles(blockMetatiles), tilesetColumns(tilesetColumns)
+    {
+    }
+
+    MapImporter::Result MapImporter::import(const QString& filename) const
+    {
+        Result result;
+        result.valid = false;
+
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            result.error = QObject::tr("Failed to open '%1' for reading").arg(filename);
+            return result;
+        }
+
+        Layer layer;
+        layer.width = 0;
+        layer.height = 0;
+        layer.firstGid = 1;
+        bool ok = QFileInfo(filename).suffix().toLower() == "csv"
+            ? readCSV(&file, &layer, &result.error)
+            : readTMX(&file, &layer, &result.error);
+        if(!ok)
+        {
+            result.error = QObject::tr("'%1' could not be imported: %2").arg(filename).arg(result.error);
+            return result;
+        }
+        return encode(layer);
+    }
+
+    bool MapImporter::readTMX(QIODevice* device, Layer* layer, QString* error) const
+    {
+        QXmlStreamReader xml(device);
+        NumberStream numbers(&layer->gids);
+        QString encoding;
+        QString compression;
+        Base64Stream base64;
+        QByteArray decoded;
+        QByteArray pending;
+        QByteArray compressed;
+        bool tileset = false;
+        bool inData = false;
+        bool done = false;
+
+        while(!xml.atEnd() && !done)
+        {
+            xml.readNext();
+            if(xml.isStartElement())
+            {
+                auto name = xml.name();
+                auto attributes = xml.attributes();
+                if(name == "map")
+                {
+                    if(attributes.value("orientation") != "orthogonal" || attributes.value("infinite") == "1")
+                    {
+                        *error = QObject::tr("only finite, orthogonal maps are supported.");
+                        return false;
+                    }
+                    if(attributes.value("tilewidth").toString().toInt() != METATILE_SIZE
+                        || attributes.value("tileheight").toString().toInt() != METATILE_SIZE)
+                    {
+                        *error = QObject::tr("the map's tiles must be %1x%1 metatiles.").arg(METATILE_SIZE);
+                        return false;
+                    }
+                    layer->width = attributes.value("width").toString().toInt();
+                    layer->height = attributes.value("height").toString().toInt();
+                    layer->gids.reserve(layer->width * layer->height);
+                }
+                else if(name == "tileset" && !tileset)
+                {
+                    // Only the first tileset is used; an external one can't be checked without reading it.
+                    tileset = true;
+                    layer->firstGid = attributes.value("firstgid").toString().toInt();
+                    if(attributes.hasAttribute("columns") && attributes.value("columns").toString().toInt() != tilesetColumns)
+                    {
+                        *error = QObject::tr("the tileset is %1 metatile(s) wide, but the source image is %2.")
+                            .arg(attributes.value("columns").toString()).arg(tilesetColumns);
+                        return false;
+                    }
+                }
+                else if(name == "data")
+                {
+                    inData = true;
+                    encoding = attributes.value("encoding").toString();
+                    compression = attributes.value("compression").toString();
+                    if(!(encoding.isEmpty() || encoding == "csv" || encoding == "base64")
+                        || !(compression.isEmpty() || compression == "zlib"))
+                    {
+                        *error = QObject::tr("layer data in %1 %2 isn't supported; use CSV, Base64 or zlib.").arg(encoding).arg(compression);
+                        return false;
+                    }
+
+                    // qUncompress wants the zlib stream after its big-endian size, so that's reserved up front.
+                    if(compression == "zlib")
+                    {
+                        int expected = layer->width * layer->height * 4;
+                        compressed.reserve(expected / 4);
+                        compressed.append(char(expected >> 24));
+                        compressed.append(char(expected >> 16));
+                        compressed.append(char(expected >> 8));
+                        compressed.append(char(expected));
+                    }
+                }
+                else if(name == "tile" && inData)
+                {
+                    layer->gids.append(attributes.value("gid").toString().toUInt());
+                }
+                else if(name == "chunk")
+                {
+                    *error = QObject::tr("only finite, orthogonal maps are supported.");
+                    return false;
+                }
+            }
+            else if(xml.isCharacters() && inData)
+            {
+                auto text = xml.text();
+                if(encoding == "csv" && !numbers.feed(text.unicode(), text.size()))
+                {
+                    *error = QObject::tr("the CSV layer data is malformed.");
+                    return false;
+                }
+                else if(encoding == "base64")
+                {
+                    // Decoded as it arrives: plain gids go straight into the layer, zlib data is gathered to inflate.
+                    decoded.clear();
+                    if(!base64.feed(text.unicode(), text.size(), &decoded))
+                    {
+                        *error = QObject::tr("the Base64 layer data is malformed.");
+                        return false;
+                    }
+                    if(compression == "zlib")
+                    {
+                        compressed.append(decoded);
+                    }
+                    else
+                    {
+                        appendGids(&pending, decoded, &layer->gids);
+                    }
+                }
+            }
+            else if(xml.isEndElement() && xml.name() == "data")
+            {
+                // A single tile layer makes the map; any others are left for other tools.
+                numbers.finish();
+                done = true;
+            }
+        }
+        if(xml.hasError())
+        {
+            *error = xml.errorString();
+            return false;
+        }
+
+        if(encoding == "base64")
+        {
+            decoded.clear();
+            base64.finish(&decoded);
+            if(compression == "zlib")
+            {
+                compressed.append(decoded);
+                appendGids(&pending, qUncompress(compressed), &layer->gids);
+            }
+            else
+            {
+                appendGids(&pending, decoded, &layer->gids);
+            }
+        }
+        if(!done)
+        {
+            *error = QObject::tr("the map has no tile layer.");
+            return false;
+        }
+        return true;
+    }
+
+    bool MapImporter::readCSV(QIODevice* device, Layer* layer, QString* error) const
+    {
+        // Tiled's CSV export holds tile ids rather than gids, with -1 for empty cells.
+        NumberStream numbers(&layer->gids);
+        char buffer[READ_BYTES];
+        for(qint64 size; (size = device->read(buffer, sizeof(buffer))) > 0;)
+        {
+            if(!numbers.feed(buffer, int(size)))
+            {
+                *error = QObject::tr("the CSV data is malformed.");
+                return false;
+            }
+        }
+        numbers.finish();
+
+        layer->width = numbers.width ? numbers.width : layer->gids.count();
+        layer->height = layer->width ? layer->gids.count() / layer->width : 0;
+        for(int i = 0, end = layer->gids.count(); i != end; ++i)
+        {
+            layer->gids[i] += 1;
+        }
+        if(layer->width * layer->height != layer->gids.count())
+        {
+            *error = QObject::tr("the rows aren't all %1 cell(s) wide.").arg(layer->width);
+            return false;
+        }
+        layer->firstGid = 1;
+        return true;
+    }
+
+    MapImporter::Result MapImporter::encode(const Layer& layer) const
+    {
+        Result result;
+        result.valid = false;
+        result.width = layer.width;
+        result.height = layer.height;
+        result.screensWide = (layer.width + SCREEN_COLUMNS - 1) / SCREEN_COLUMNS;
+        result.screensHigh = (layer.height + SCREEN_ROWS - 1) / SCREEN_ROWS;
+        result.rawBytes = 0;
+
+        int cells = layer.width * layer.height;
+        if(cells == 0 || layer.gids.count() != cells)
+        {
+            result.error = QObject::tr("The layer has %1 cell(s), but the map is %2x%3.").arg(layer.gids.count()).arg(layer.width).arg(layer.height);
+            return result;
+        }
+        if(result.screensWide > 255 || result.screensHigh > 255)
+        {
+            result.error = QObject::tr("The map is %1x%2 screens; at most 255 fit each way.").arg(result.screensWide).arg(result.screensHigh);
+            return result;
+        }
+
+        // Resolve every cell to the metatile its tileset block became; empty cells use metatile 0.
+        QByteArray metatiles(cells, '\0');
+        for(int i = 0; i != cells; ++i)
+        {
+            quint32 gid = layer.gids[i];
+            if(gid & FLIP_FLAGS)
+            {
+                result.error = QObject::tr("Cell (%1, %2) is flipped or rotated, which metatiles can't be.").arg(i % layer.width).arg(i / layer.width);
+                return result;
+            }
+            if(gid == 0)
+            {
+                continue;
+            }
+            int id = int(gid) - layer.firstGid;
+            if(id < 0 || id >= blockMetatiles.count())
+            {
+                result.error = QObject::tr("Cell (%1, %2) uses tile %3, but the tileset has %4.").arg(i % layer.width).arg(i / layer.width).arg(id).arg(blockMetatiles.count());
+                return result;
+            }
+            int metatile = blockMetatiles[id];
+            if(metatile > 255)
+            {
+                result.error = QObject::tr("Cell (%1, %2) uses metatile %3, but a map entry can only index 256.").arg(i % layer.width).arg(i / layer.width).arg(metatile);
+                return result;
+            }
+            metatiles[i] = char(metatile);
+        }
+
+        // Screens across then down, each column top to bottom as its own RLE stream with its own offset,
+        // so scrolling can decode just the column coming into view. Identical columns share one stream.
+        int screens = result.screensWide * result.screensHigh;
+        int header = 2 + screens * SCREEN_COLUMNS * 2;
+        QByteArray table;
+        table.append(char(result.screensWide));
+        table.append(char(result.screensHigh));
+        QByteArray body;
+        QHash<QByteArray, int> offsets;
+        QByteArray column(SCREEN_ROWS, '\0');
+        for(int sy = 0; sy != result.screensHigh; ++sy)
+        {
+            for(int sx = 0; sx != result.screensWide; ++sx)
+            {
+                for(int c = 0; c != SCREEN_COLUMNS; ++c)
+                {
+                    int x = sx * SCREEN_COLUMNS + c;
+                    for(int r = 0; r != SCREEN_ROWS; ++r)
+                    {
+                        int y = sy * SCREEN_ROWS + r;
+                        column[r] = x < layer.width && y < layer.height ? metatiles[y * layer.width + x] : '\0';
+                    }
+
+                    int offset = offsets.value(column, -1);
+                    if(offset == -1)
+                    {
+                        // A column has fewer cells than byte values, so there's always a free RLE tag.
+                        bool ok;
+                        auto packed = Codec::compress(Codec::RLE, column, &ok);
+                        offset = header + body.size();
+                        if(offset > MAX_OFFSET)
+                        {
+                            result.error = QObject::tr("The map needs more than %1 bytes, past what the column index can address.").arg(MAX_OFFSET);
+                            return result;
+                        }
+                        offsets.insert(column, offset);
+                        body.append(packed);
+                    }
+                    table.append(char(offset & 0xFF));
+                    table.append(char(offset >> 8));
+                }
+            }
+        }
+
+        result.data = table + body;
+        result.rawBytes = 2 + screens * SCREEN_COLUMNS * SCREEN_ROWS;
+        result.valid = true;
+        return result;
+    }
+}
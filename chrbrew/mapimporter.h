@@ -0,0 +1,47 @@
+#ifndef MAPIMPORTER_H
+#define MAPIMPORTER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Reads a map of metatiles made in Tiled (TMX, or a CSV layer export) and packs it a screen at a time:
+    // each column of a screen is RLE packed on its own, with an offset per column for random access.
+    class MapImporter
+    {
+        public:
+            static const int METATILE_SIZE = 16;
+            static const int SCREEN_COLUMNS = 16;
+            static const int SCREEN_ROWS = 15;
+
+            struct Result
+            {
+                bool valid;
+                QString error;
+                int width;
+                int height;
+                int screensWide;
+                int screensHigh;
+                int rawBytes;
+                QByteArray data;
+            };
+
+            // The tileset is the metatile source image, so a Tiled tile id is a block of it in reading order,
+            // and blockMetatiles maps each block to the metatile it was merged into.
+            MapImporter(const QVector<int>& blockMetatiles, int tilesetColumns);
+
+            Result import(const QString& filename) const;
+
+        private:
+            struct Layer;
+
+            bool readTMX(QIODevice* device, Layer* layer, QString* error) const;
+            bool readCSV(QIODevice* device, Layer* layer, QString* error) const;
+            Result encode(const Layer& layer) const;
+
+            QVector<int> blockMetatiles;
+            int tilesetColumns;
+    };
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "metatilebuilder.h"
+#include "tileencoder.h"
+#include "tilestore.h"
+
+namespace chrbrew
+{
+    using overbrew::TileStore;
+
+    MetatileBuilder::MetatileBuilder(const QImage& image, const QList<int>& conversions)
+        : image(image), conversions(conversions)
+    {
+    }
+
+    MetatileBuilder::Result MetatileBuilder::build() const
+    {
+        Result result;
+        result.valid = false;
+        result.columns = image.width() / BLOCK_SIZE;
+        result.rows = image.height() / BLOCK_SIZE;
+        result.mixedBlocks = 0;
+
+        auto lookup = TileEncoder::lookup(conversions);
+        auto paletteLookup = TileEncoder::paletteLookup(lookup);
+
+        int blocks = result.columns * result.rows;
+        QMultiHash<uint, int> tileIndex;
+        QHash<quint64, int> blockIndex;
+        tileIndex.reserve(qMin(blocks * 4, MAX_TILES));
+        blockIndex.reserve(blocks);
+        result.map.reserve(blocks);
+
+        char tile[TILE_BYTES];
+        for(int r = 0; r != result.rows; ++r)
+        {
+            for(int c = 0; c != result.columns; ++c)
+            {
+                // Block key: four 14-bit tile indices, then the palette in the top byte.
+                quint64 key = 0;
+                int used = 0;
+                for(int q = 0; q != 4; ++q)
+                {
+                    int x = c * BLOCK_SIZE + (q & 1) * TILE_SIZE;
+                    int y = r * BLOCK_SIZE + (q >> 1) * TILE_SIZE;
+                    TileEncoder::encode(image, x, y, TILE_SIZE, lookup.constData(), tile);
+                    used |= TileEncoder::paletteMask(image, x, y, TILE_SIZE, paletteLookup.constData(), tile);
+
+                    // Tiles are found by hash and compared against the CHR built so far, so nothing is copied to probe.
+                    uint tileHash = TileStore::hash(tile, TILE_SIZE);
+                    int index = -1;
+                    for(auto it = tileIndex.constFind(tileHash); it != tileIndex.constEnd() && it.key() == tileHash; ++it)
+                    {
+                        if(TileStore::equals(tile, result.chr.constData() + it.value() * TILE_BYTES, TILE_SIZE))
+                        {
+                            index = it.value();
+                            break;
+                        }
+                    }
+                    if(index == -1)
+                    {
+                        index = tileIndex.count();
+                        if(index == MAX_TILES)
+                        {
+                            result.error = QObject::tr("The image has more than %1 unique tiles.").arg(MAX_TILES);
+                            return result;
+                        }
+                        tileIndex.insert(tileHash, index);
+                        result.chr.append(tile, TILE_BYTES);
+                    }
+                    key |= quint64(index) << (q * 14);
+                }
+
+                // Mixed blocks get the highest palette they use.
+                if(used & (used - 1))
+                {
+                    ++result.mixedBlocks;
+                }
+                int palette = 0;
+                while(used >> (palette + 1))
+                {
+                    ++palette;
+                }
+                key |= quint64(palette) << 56;
+
+                auto it = blockIndex.constFind(key);
+                if(it == blockIndex.constEnd())
+                {
+                    it = blockIndex.insert(key, result.palettes.count());
+                    result.topLeft.append(key & 0x3FFF);
+                    result.topRight.append((key >> 14) & 0x3FFF);
+                    result.bottomLeft.append((key >> 28) & 0x3FFF);
+                    result.bottomRight.append((key >> 42) & 0x3FFF);
+                    result.palettes.append(palette);
+                }
+                result.map.append(it.value());
+            }
+        }
+
+        result.valid = true;
+        return result;
+    }
+}
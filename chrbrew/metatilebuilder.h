@@ -0,0 +1,44 @@
+#ifndef METATILEBUILDER_H
+#define METATILEBUILDER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Cuts an image into 16x16 blocks of 2x2 hardware tiles, merging duplicate tiles and duplicate blocks.
+    class MetatileBuilder
+    {
+        public:
+            static const int TILE_SIZE = 8;
+            static const int BLOCK_SIZE = 16;
+            static const int TILE_BYTES = 16;
+            static const int MAX_TILES = 1 << 14;
+
+            struct Result
+            {
+                bool valid;
+                QString error;
+                QByteArray chr;
+                QVector<int> topLeft;
+                QVector<int> topRight;
+                QVector<int> bottomLeft;
+                QVector<int> bottomRight;
+                QVector<int> palettes;
+                QVector<int> map;
+                int columns;
+                int rows;
+                int mixedBlocks;
+            };
+
+            // Conversions map each image color to a 2-bit color index, plus 4 x its palette.
+            MetatileBuilder(const QImage& image, const QList<int>& conversions);
+
+            Result build() const;
+
+        private:
+            QImage image;
+            QList<int> conversions;
+    };
+}
+
+#endif
@@ -0,0 +1,156 @@
+#include <cstring>
+
+#include "rompatcher.h"
+#include "atomicfile.h"
+
+namespace chrbrew
+{
+    using overbrew::AtomicFile;
+
+    namespace
+    {
+        const int IPS_MAX_OFFSET = 0xFFFFFF;
+
+        // A record at this offset would read as the end-of-file marker.
+        const int IPS_EOF_OFFSET = 0x454F46;
+    }
+
+    RomPatcher::RomPatcher(const QString& filename)
+        : filename(filename)
+    {
+    }
+
+    RomPatcher::Result RomPatcher::patch(const QByteArray& chr, int startBank, const QString& ipsFilename) const
+    {
+        Result result;
+        result.valid = false;
+        result.chrOffset = 0;
+        result.chrBanks = 0;
+        result.writtenBanks = 0;
+        result.changedBanks = 0;
+
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadWrite))
+        {
+            result.error = QObject::tr("Failed to open '%1' for writing").arg(filename);
+            return result;
+        }
+
+        QByteArray header(file.read(HEADER_BYTES));
+        if(header.size() != HEADER_BYTES || !header.startsWith("NES\x1A"))
+        {
+            result.error = QObject::tr("'%1' is not an iNES ROM.").arg(filename);
+            return result;
+        }
+
+        // NES 2.0 keeps the upper bits of both sizes in byte 9.
+        int prgUnits = quint8(header[4]);
+        int chrUnits = quint8(header[5]);
+        if((header[7] & 0x0C) == 0x08)
+        {
+            prgUnits |= (quint8(header[9]) & 0x0F) << 8;
+            chrUnits |= (quint8(header[9]) & 0xF0) << 4;
+        }
+        if(chrUnits == 0)
+        {
+            result.error = QObject::tr("'%1' has no CHR-ROM; its tiles are loaded into CHR-RAM by the program.").arg(filename);
+            return result;
+        }
+
+        qint64 chrOffset = HEADER_BYTES + (header[6] & 0x04 ? TRAINER_BYTES : 0) + qint64(prgUnits) * PRG_UNIT;
+        qint64 chrSize = qint64(chrUnits) * CHR_UNIT;
+        if(file.size() < chrOffset + chrSize)
+        {
+            result.error = QObject::tr("'%1' is truncated: the header promises %2 byte(s) of CHR-ROM at offset %3.")
+                .arg(filename).arg(chrSize).arg(chrOffset);
+            return result;
+        }
+
+        qint64 start = qint64(startBank) * BANK_BYTES;
+        if(startBank < 0 || start + chr.size() > chrSize)
+        {
+            result.error = QObject::tr("%1 byte(s) of tiles do not fit at bank %2 of the %3 KB CHR-ROM.")
+                .arg(chr.size()).arg(startBank).arg(chrSize / BANK_BYTES);
+            return result;
+        }
+
+        auto rom = file.map(0, file.size());
+        if(!rom)
+        {
+            result.error = QObject::tr("'%1' could not be mapped: %2").arg(filename).arg(file.errorString());
+            return result;
+        }
+
+        // Only banks that differ are written, so untouched pages of the ROM stay clean.
+        QList<Record> records;
+        for(qint64 at = 0; at < chr.size(); at += BANK_BYTES)
+        {
+            int size = int(qMin(qint64(BANK_BYTES), chr.size() - at));
+            auto source = chr.constData() + at;
+            auto dest = rom + chrOffset + start + at;
+            ++result.writtenBanks;
+            if(std::memcmp(source, dest, size))
+            {
+                std::memcpy(dest, source, size);
+                ++result.changedBanks;
+
+                Record record;
+                record.offset = chrOffset + start + at;
+                record.data = QByteArray(source, size);
+                if(record.offset == IPS_EOF_OFFSET)
+                {
+                    --record.offset;
+                    record.data.prepend(char(rom[record.offset]));
+                }
+                records.append(record);
+            }
+        }
+        file.unmap(rom);
+        file.close();
+
+        if(!ipsFilename.isEmpty() && !writeIPS(ipsFilename, records, &result.error))
+        {
+            return result;
+        }
+
+        result.chrOffset = chrOffset;
+        result.chrBanks = int(chrSize / BANK_BYTES);
+        result.valid = true;
+        return result;
+    }
+
+    bool RomPatcher::writeIPS(const QString& filename, const QList<Record>& records, QString* error)
+    {
+        AtomicFile file(filename);
+        if(!file.open())
+        {
+            *error = file.errorString();
+            return false;
+        }
+
+        // "PATCH", then 24-bit big-endian offsets with 16-bit big-endian sizes, then "EOF".
+        file.write(QByteArray("PATCH"));
+        foreach(const Record& record, records)
+        {
+            if(record.offset > IPS_MAX_OFFSET)
+            {
+                *error = QObject::tr("Offset %1 is past the 16 MB an IPS patch can address.").arg(record.offset);
+                file.discard();
+                return false;
+            }
+            char head[5] = {
+                char(record.offset >> 16), char(record.offset >> 8), char(record.offset),
+                char(record.data.size() >> 8), char(record.data.size())
+            };
+            file.write(head, sizeof(head));
+            file.write(record.data);
+        }
+        file.write(QByteArray("EOF"));
+        if(!file.commit())
+        {
+            *error = file.errorString();
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef ROMPATCHER_H
+#define ROMPATCHER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Writes a character set straight into the CHR-ROM of an existing iNES image, rewriting only the 1 KB banks
+    // whose tiles differ, and optionally records the same changes as an IPS patch.
+    class RomPatcher
+    {
+        public:
+            static const int HEADER_BYTES = 16;
+            static const int TRAINER_BYTES = 512;
+            static const int PRG_UNIT = 16384;
+            static const int CHR_UNIT = 8192;
+            static const int BANK_BYTES = 1024;
+
+            struct Result
+            {
+                bool valid;
+                QString error;
+                qint64 chrOffset;
+                int chrBanks;
+                int writtenBanks;
+                int changedBanks;
+            };
+
+            explicit RomPatcher(const QString& filename);
+
+            // Places the tiles at the given 1 KB bank of CHR-ROM.
+            Result patch(const QByteArray& chr, int startBank, const QString& ipsFilename = QString()) const;
+
+        private:
+            struct Record
+            {
+                qint64 offset;
+                QByteArray data;
+            };
+
+            static bool writeIPS(const QString& filename, const QList<Record>& records, QString* error);
+
+            QString filename;
+    };
+}
+
+#endif
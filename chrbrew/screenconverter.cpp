@@ -0,0 +1,180 @@
+#include "screenconverter.h"
+#include "tileencoder.h"
+#include "tilestore.h"
+
+namespace chrbrew
+{
+    using overbrew::TileStore;
+
+    namespace
+    {
+        // Index of the tile among those packed in chr, found by hash; -1 if it isn't there yet.
+        int findTile(const QMultiHash<uint, int>& index, const QByteArray& chr, const char* tile)
+        {
+            uint tileHash = TileStore::hash(tile, ScreenConverter::TILE_SIZE);
+            for(auto it = index.constFind(tileHash); it != index.constEnd() && it.key() == tileHash; ++it)
+            {
+                if(TileStore::equals(tile, chr.constData() + it.value() * ScreenConverter::TILE_BYTES, ScreenConverter::TILE_SIZE))
+                {
+                    return it.value();
+                }
+            }
+            return -1;
+        }
+    }
+
+    struct ScreenConverter::Job
+    {
+        QString name;
+        QImage image;
+        QVector<uchar> lookup;
+        QVector<uchar> paletteLookup;
+        int x;
+        int y;
+    };
+
+    struct ScreenConverter::Local
+    {
+        QByteArray tiles;
+        QVector<int> cells;
+        QByteArray attributes;
+        int mixedAreas;
+    };
+
+    void ScreenConverter::addImage(const QString& name, const QImage& image, const QList<int>& conversions)
+    {
+        int columns = image.width() / SCREEN_WIDTH;
+        int rows = image.height() / SCREEN_HEIGHT;
+
+        auto lookup = TileEncoder::lookup(conversions);
+        auto paletteLookup = TileEncoder::paletteLookup(lookup);
+
+        for(int r = 0; r != rows; ++r)
+        {
+            for(int c = 0; c != columns; ++c)
+            {
+                Job job;
+                job.name = columns * rows == 1 ? name : QString("%1_%2").arg(name).arg(r * columns + c);
+                job.image = image;
+                job.lookup = lookup;
+                job.paletteLookup = paletteLookup;
+                job.x = c * SCREEN_WIDTH;
+                job.y = r * SCREEN_HEIGHT;
+                jobs.append(job);
+            }
+        }
+    }
+
+    ScreenConverter::Result ScreenConverter::convert() const
+    {
+        Result result;
+        result.valid = false;
+        result.mixedAreas = 0;
+        if(jobs.isEmpty())
+        {
+            result.error = QObject::tr("No image is at least %1x%2 pixels.").arg(SCREEN_WIDTH).arg(SCREEN_HEIGHT);
+            return result;
+        }
+
+        // Each screen finds its own unique tiles in parallel...
+        auto locals = QtConcurrent::blockingMapped<QList<Local> >(jobs, &ScreenConverter::convertScreen);
+
+        // ...then they are merged into the shared index in screen order, so the output never depends on scheduling.
+        QMultiHash<uint, int> tileIndex;
+        for(int s = 0, end = locals.count(); s != end; ++s)
+        {
+            const auto& local = locals[s];
+            QVector<int> global(local.tiles.size() / TILE_BYTES);
+            for(int t = 0, count = global.count(); t != count; ++t)
+            {
+                auto tile = local.tiles.constData() + t * TILE_BYTES;
+                global[t] = findTile(tileIndex, result.chr, tile);
+                if(global[t] == -1)
+                {
+                    global[t] = tileIndex.count();
+                    tileIndex.insert(TileStore::hash(tile, TILE_SIZE), global[t]);
+                    result.chr.append(tile, TILE_BYTES);
+                }
+            }
+
+            Screen screen;
+            screen.name = jobs[s].name;
+            screen.nametable.resize(NAMETABLE_BYTES);
+            for(int i = 0; i != NAMETABLE_BYTES; ++i)
+            {
+                screen.nametable[i] = char(global[local.cells[i]]);
+            }
+            screen.attributes = local.attributes;
+            result.screens.append(screen);
+            result.mixedAreas += local.mixedAreas;
+        }
+
+        if(tileIndex.count() > 256)
+        {
+            result.error = QObject::tr("The screens use %1 unique tiles, but a nametable can only index 256.").arg(tileIndex.count());
+            return result;
+        }
+
+        result.valid = true;
+        return result;
+    }
+
+    ScreenConverter::Local ScreenConverter::convertScreen(const Job& job)
+    {
+        const int columns = SCREEN_WIDTH / TILE_SIZE;
+        const int rows = SCREEN_HEIGHT / TILE_SIZE;
+
+        Local local;
+        local.cells.resize(columns * rows);
+        local.mixedAreas = 0;
+
+        // Palettes used in each 16x16 area, 16 across and 15 down, with palette p in bit p.
+        QVector<int> palettes(16 * 15, 0);
+
+        QMultiHash<uint, int> tileIndex;
+        char tile[TILE_BYTES];
+        for(int r = 0; r != rows; ++r)
+        {
+            for(int c = 0; c != columns; ++c)
+            {
+                int x = job.x + c * TILE_SIZE;
+                int y = job.y + r * TILE_SIZE;
+                TileEncoder::encode(job.image, x, y, TILE_SIZE, job.lookup.constData(), tile);
+                palettes[(r / 2) * 16 + c / 2] |= TileEncoder::paletteMask(job.image, x, y, TILE_SIZE, job.paletteLookup.constData(), tile);
+
+                int index = findTile(tileIndex, local.tiles, tile);
+                if(index == -1)
+                {
+                    index = tileIndex.count();
+                    tileIndex.insert(TileStore::hash(tile, TILE_SIZE), index);
+                    local.tiles.append(tile, TILE_BYTES);
+                }
+                local.cells[r * columns + c] = index;
+            }
+        }
+
+        // Each attribute byte packs a 2x2 group of areas: top-left in the low bits, bottom-right in the high bits.
+        local.attributes = QByteArray(ATTRIBUTE_BYTES, '\0');
+        for(int y = 0; y != 15; ++y)
+        {
+            for(int x = 0; x != 16; ++x)
+            {
+                // Mixed areas get the highest palette they use.
+                int used = palettes[y * 16 + x];
+                if(used & (used - 1))
+                {
+                    ++local.mixedAreas;
+                }
+                int palette = 0;
+                while(used >> (palette + 1))
+                {
+                    ++palette;
+                }
+                int shift = ((y & 1) * 2 + (x & 1)) * 2;
+                int index = (y / 2) * 8 + x / 2;
+                local.attributes[index] = local.attributes[index] | char(palette << shift);
+            }
+        }
+        return local;
+    }
+}
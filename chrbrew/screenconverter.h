@@ -0,0 +1,51 @@
+#ifndef SCREENCONVERTER_H
+#define SCREENCONVERTER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Turns screen-sized images into a nametable and attribute table each, sharing one deduplicated character set.
+    class ScreenConverter
+    {
+        public:
+            static const int SCREEN_WIDTH = 256;
+            static const int SCREEN_HEIGHT = 240;
+            static const int TILE_SIZE = 8;
+            static const int TILE_BYTES = 16;
+            static const int NAMETABLE_BYTES = 960;
+            static const int ATTRIBUTE_BYTES = 64;
+
+            struct Screen
+            {
+                QString name;
+                QByteArray nametable;
+                QByteArray attributes;
+            };
+
+            struct Result
+            {
+                bool valid;
+                QString error;
+                QByteArray chr;
+                QVector<Screen> screens;
+                int mixedAreas;
+            };
+
+            // Images larger than a screen are split into as many whole screens as fit, row by row.
+            // Conversions map each image color to a 2-bit color index, plus 4 x its palette.
+            void addImage(const QString& name, const QImage& image, const QList<int>& conversions);
+
+            Result convert() const;
+
+        private:
+            struct Job;
+            struct Local;
+
+            static Local convertScreen(const Job& job);
+
+            QList<Job> jobs;
+    };
+}
+
+#endif
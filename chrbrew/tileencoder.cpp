@@ -0,0 +1,124 @@
+#include "tileencoder.h"
+#include "tilestore.h"
+
+namespace chrbrew
+{
+    using overbrew::TileStore;
+
+    namespace
+    {
+        // A run of tile rows, encoded into its own slice of the output.
+        struct Band
+        {
+            const QImage* image;
+            const uchar* lookup;
+            int cellHeight;
+            int padding;
+            int columns;
+            int firstRow;
+            int rows;
+            char* dest;
+        };
+
+        void encodeBand(Band& band)
+        {
+            int cellBytes = band.cellHeight * 2;
+            auto dest = band.dest;
+            for(int r = band.firstRow, end = band.firstRow + band.rows; r != end; ++r)
+            {
+                for(int c = 0; c != band.columns; ++c, dest += cellBytes)
+                {
+                    TileEncoder::encode(*band.image,
+                        c * (TileEncoder::WIDTH + band.padding) + band.padding,
+                        r * (band.cellHeight + band.padding) + band.padding,
+                        band.cellHeight, band.lookup, dest);
+                }
+            }
+        }
+    }
+
+    QVector<uchar> TileEncoder::lookup(const QList<int>& conversions)
+    {
+        QVector<uchar> result(256, 0);
+        for(int i = 0, end = qMin(conversions.count(), 256); i != end; ++i)
+        {
+            result[i] = conversions[i];
+        }
+        return result;
+    }
+
+    void TileEncoder::encode(const QImage& image, int x, int y, int rows, const uchar* lookup, char* dest)
+    {
+        for(int j = 0; j != rows; ++j)
+        {
+            auto line = image.constScanLine(y + j) + x;
+            unsigned char low = 0;
+            unsigned char high = 0;
+            for(int i = 0; i != WIDTH; ++i)
+            {
+                int color = lookup[line[i]];
+                low = (low << 1) | (color & 0x1);
+                high = (high << 1) | ((color & 0x2) >> 1);
+            }
+            dest[j * 2] = low;
+            dest[j * 2 + 1] = high;
+        }
+    }
+
+    QVector<uchar> TileEncoder::paletteLookup(const QVector<uchar>& lookup)
+    {
+        QVector<uchar> result(lookup.count());
+        for(int i = 0, end = lookup.count(); i != end; ++i)
+        {
+            result[i] = (lookup[i] >> 2) & 0x3;
+        }
+        return result;
+    }
+
+    int TileEncoder::paletteMask(const QImage& image, int x, int y, int rows, const uchar* paletteLookup, const char* tile)
+    {
+        // The palettes are encoded as a tile of their own, so each one's pixels can be picked out a row at a time.
+        QVarLengthArray<char, BYTES * 2> palettes(rows * 2);
+        encode(image, x, y, rows, paletteLookup, palettes.data());
+
+        int mask = 0;
+        for(int j = 0; j != rows; ++j)
+        {
+            quint8 opaque = quint8(tile[j * 2]) | quint8(tile[j * 2 + 1]);
+            for(int p = 0; p != 4; ++p)
+            {
+                if(TileStore::colorMask(palettes[j * 2], palettes[j * 2 + 1], p) & opaque)
+                {
+                    mask |= 1 << p;
+                }
+            }
+        }
+        return mask;
+    }
+
+    QByteArray TileEncoder::encodeImage(const QImage& image, const QVector<uchar>& lookup, int cellHeight, int padding)
+    {
+        int columns = image.width() / (WIDTH + padding);
+        int rows = image.height() / (cellHeight + padding);
+        int cellBytes = cellHeight * 2;
+
+        QByteArray result(columns * rows * cellBytes, '\0');
+        if(result.isEmpty())
+        {
+            return result;
+        }
+
+        // Bands of tile rows are encoded concurrently; each owns a fixed slice, so the output matches a serial pass.
+        int bandCount = qMin(rows, qMax(QThread::idealThreadCount(), 1) * 4);
+        QList<Band> bands;
+        for(int b = 0, row = 0; b != bandCount; ++b)
+        {
+            Band band = { &image, lookup.constData(), cellHeight, padding, columns, row, rows / bandCount + (b < rows % bandCount ? 1 : 0), 0 };
+            band.dest = result.data() + row * columns * cellBytes;
+            bands.append(band);
+            row += band.rows;
+        }
+        QtConcurrent::blockingMap(bands, encodeBand);
+        return result;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef TILEENCODER_H
+#define TILEENCODER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Encodes indexed pixels as raw tiles: a low and high bitplane byte per row.
+    class TileEncoder
+    {
+        public:
+            static const int WIDTH = 8;
+            static const int HEIGHT = 8;
+            static const int BYTES = 16;
+
+            // Maps every possible color index through the conversions, so encoding needs no bounds checks.
+            static QVector<uchar> lookup(const QList<int>& conversions);
+
+            static void encode(const QImage& image, int x, int y, int rows, const uchar* lookup, char* dest);
+
+            // The palette in bits 2-3 of each converted color, as a lookup of its own for paletteMask.
+            static QVector<uchar> paletteLookup(const QVector<uchar>& lookup);
+
+            // The palettes that the opaque pixels of an encoded tile use, as a bitmask with palette p in bit p.
+            static int paletteMask(const QImage& image, int x, int y, int rows, const uchar* paletteLookup, const char* tile);
+
+            // Every cell of the image, left to right then top to bottom; tall cells give their top tile first.
+            // Padded images have a one pixel border above and left of each cell, which is skipped.
+            static QByteArray encodeImage(const QImage& image, const QVector<uchar>& lookup, int cellHeight, int padding = 0);
+    };
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include <climits>
+#include <queue>
+
+#include "tilereducer.h"
+#include "tilestore.h"
+
+namespace chrbrew
+{
+    using overbrew::TileStore;
+
+    namespace
+    {
+        int popcount(quint64 value)
+        {
+            value = value - ((value >> 1) & Q_UINT64_C(0x5555555555555555));
+            value = (value & Q_UINT64_C(0x3333333333333333)) + ((value >> 2) & Q_UINT64_C(0x3333333333333333));
+            value = (value + (value >> 4)) & Q_UINT64_C(0x0F0F0F0F0F0F0F0F);
+            return int((value * Q_UINT64_C(0x0101010101010101)) >> 56);
+        }
+
+        struct Candidate
+        {
+            qint64 cost;
+            int unit;
+            int nearest;
+            int unitCount;
+            int nearestCount;
+
+            bool operator<(const Candidate& other) const
+            {
+                // Reversed for a min-heap; ties go to the lower unit so results are reproducible.
+                if(cost != other.cost)
+                {
+                    return cost > other.cost;
+                }
+                if(unit != other.unit)
+                {
+                    return unit > other.unit;
+                }
+                return nearest > other.nearest;
+            }
+        };
+    }
+
+    // A BK-tree over unit planes. The shade distance is an L1 metric, so the triangle inequality
+    // prunes every subtree whose edge is too far from the query to beat the best match so far.
+    struct TileReducer::Index
+    {
+        struct Node
+        {
+            int unit;
+            QMap<int, int> children;
+        };
+
+        Index(const QVector<quint64>& planes, int words)
+            : planes(planes), words(words)
+        {
+        }
+
+        const quint64* at(int unit) const
+        {
+            return planes.constData() + unit * words;
+        }
+
+        void insert(int unit)
+        {
+            if(nodes.isEmpty())
+            {
+                Node node = { unit, QMap<int, int>() };
+                nodes.append(node);
+                return;
+            }
+            int current = 0;
+            forever
+            {
+                int d = distance(at(unit), at(nodes[current].unit), words);
+                auto it = nodes[current].children.constFind(d);
+                if(it == nodes[current].children.constEnd())
+                {
+                    Node node = { unit, QMap<int, int>() };
+                    nodes[current].children.insert(d, nodes.count());
+                    nodes.append(node);
+                    return;
+                }
+                current = it.value();
+            }
+        }
+
+        // Nearest live unit other than the query; -1 if there is none.
+        int nearest(int unit, const QVector<bool>& alive, int* best) const
+        {
+            // Half the range, so the pruning bounds below can't overflow.
+            int found = -1;
+            *best = INT_MAX / 2;
+            QVector<int> stack;
+            if(!nodes.isEmpty())
+            {
+                stack.append(0);
+            }
+            while(!stack.isEmpty())
+            {
+                const auto& node = nodes[stack.last()];
+                stack.pop_back();
+
+                int d = distance(at(unit), at(node.unit), words);
+                if(node.unit != unit && alive[node.unit] && (d < *best || (d == *best && node.unit < found)))
+                {
+                    *best = d;
+                    found = node.unit;
+                }
+                for(auto it = node.children.constBegin(); it != node.children.constEnd(); ++it)
+                {
+                    if(it.key() >= d - *best && it.key() <= d + *best)
+                    {
+                        stack.append(it.value());
+                    }
+                }
+            }
+            return found;
+        }
+
+        const QVector<quint64>& planes;
+        int words;
+        QVector<Node> nodes;
+    };
+
+    TileReducer::TileReducer(const QByteArray& chr, int unitBytes)
+        : chr(chr), unitBytes(unitBytes)
+    {
+    }
+
+    int TileReducer::distance(const quint64* a, const quint64* b, int words)
+    {
+        // Words alternate: 8 rows of low plane, then 8 rows of high plane.
+        // Per pixel, differing low bits add 1. Differing high bits add 2, unless the low bits also differ
+        // and the brighter pixel's low bit is clear (2 against 1), where the difference is only 1.
+        int total = 0;
+        for(int i = 0; i != words; i += 2)
+        {
+            quint64 low = a[i] ^ b[i];
+            quint64 high = a[i + 1] ^ b[i + 1];
+            quint64 brightLow = (a[i + 1] & a[i]) | (b[i + 1] & b[i]);
+            total += popcount(low) + 2 * popcount(high & (~low | brightLow));
+        }
+        return total;
+    }
+
+    QString TileReducer::mapFilename(const QString& chrFilename)
+    {
+        QFileInfo info(chrFilename);
+        return info.dir().filePath(info.completeBaseName() + "_map.bin");
+    }
+
+    QByteArray TileReducer::encodeMap(const QVector<int>& map, int units)
+    {
+        QByteArray bytes;
+        bool wide = units > 256;
+        bytes.reserve(map.count() * (wide ? 2 : 1));
+        foreach(int unit, map)
+        {
+            bytes.append(char(unit & 0xFF));
+            if(wide)
+            {
+                bytes.append(char(unit >> 8));
+            }
+        }
+        return bytes;
+    }
+
+    TileReducer::Result TileReducer::reduce(int budget) const
+    {
+        Result result;
+        result.valid = false;
+        result.uniqueUnits = 0;
+        result.mergedUnits = 0;
+        result.totalDistance = 0;
+
+        if(budget < 1)
+        {
+            result.error = QObject::tr("The tile budget must be at least one unit.");
+            return result;
+        }
+
+        // Merge exact duplicates first; each unique unit remembers how many cells use it.
+        int cells = chr.size() / unitBytes;
+        int rows = unitBytes / 2;
+        QMultiHash<uint, int> uniqueIndex;
+        QVector<int> cellUnit(cells);
+        QVector<int> uses;
+        QList<QByteArray> units;
+        for(int c = 0; c != cells; ++c)
+        {
+            auto unit = chr.constData() + c * unitBytes;
+            uint unitHash = TileStore::hash(unit, rows);
+            int found = -1;
+            for(auto it = uniqueIndex.constFind(unitHash); it != uniqueIndex.constEnd() && it.key() == unitHash; ++it)
+            {
+                if(TileStore::equals(unit, units[it.value()].constData(), rows))
+                {
+                    found = it.value();
+                    break;
+                }
+            }
+            if(found == -1)
+            {
+                found = units.count();
+                uniqueIndex.insert(unitHash, found);
+                units.append(QByteArray(unit, unitBytes));
+                uses.append(0);
+            }
+            cellUnit[c] = found;
+            ++uses[found];
+        }
+
+        // Pack each 8-row tile as a low and a high plane word.
+        int count = units.count();
+        int words = unitBytes / 8;
+        QVector<quint64> planes(count * words, 0);
+        for(int u = 0; u != count; ++u)
+        {
+            const auto& unit = units[u];
+            for(int row = 0; row != rows; ++row)
+            {
+                auto word = planes.data() + u * words + row / 8 * 2;
+                word[0] |= quint64(uchar(unit[row * 2])) << (row % 8 * 8);
+                word[1] |= quint64(uchar(unit[row * 2 + 1])) << (row % 8 * 8);
+            }
+        }
+
+        Index index(planes, words);
+        for(int u = 0; u != count; ++u)
+        {
+            index.insert(u);
+        }
+
+        // Merging folds the less used unit into the more used one, so the cost is distance times the cells that change.
+        QVector<bool> alive(count, true);
+        QVector<int> replacement(count);
+        for(int u = 0; u != count; ++u)
+        {
+            replacement[u] = u;
+        }
+        std::priority_queue<Candidate> queue;
+        auto propose = [&](int unit)
+        {
+            int d;
+            int nearest = index.nearest(unit, alive, &d);
+            if(nearest != -1)
+            {
+                Candidate candidate = { qint64(d) * qMin(uses[unit], uses[nearest]), unit, nearest, uses[unit], uses[nearest] };
+                queue.push(candidate);
+            }
+        };
+        for(int u = 0; u != count; ++u)
+        {
+            propose(u);
+        }
+
+        int remaining = count;
+        while(remaining > budget && !queue.empty())
+        {
+            auto candidate = queue.top();
+            queue.pop();
+            if(!alive[candidate.unit])
+            {
+                continue;
+            }
+            if(!alive[candidate.nearest] || uses[candidate.unit] != candidate.unitCount || uses[candidate.nearest] != candidate.nearestCount)
+            {
+                propose(candidate.unit);
+                continue;
+            }
+
+            int keep = candidate.unit;
+            int drop = candidate.nearest;
+            if(uses[drop] > uses[keep] || (uses[drop] == uses[keep] && drop < keep))
+            {
+                qSwap(keep, drop);
+            }
+            alive[drop] = false;
+            replacement[drop] = keep;
+            uses[keep] += uses[drop];
+            --remaining;
+            ++result.mergedUnits;
+            propose(keep);
+        }
+
+        // Lay out the survivors in order of first use and remap every cell.
+        QVector<int> outputIndex(count, -1);
+        result.map.resize(cells);
+        result.changed.resize(cells);
+        result.sheet.reserve(chr.size());
+        for(int c = 0; c != cells; ++c)
+        {
+            int original = cellUnit[c];
+            int unit = original;
+            while(replacement[unit] != unit)
+            {
+                unit = replacement[unit];
+            }
+            if(outputIndex[unit] == -1)
+            {
+                outputIndex[unit] = result.uniqueUnits++;
+                result.chr.append(units[unit]);
+            }
+            result.map[c] = outputIndex[unit];
+            result.changed[c] = unit != original;
+            result.sheet.append(units[unit]);
+            if(unit != original)
+            {
+                result.totalDistance += distance(planes.constData() + original * words, planes.constData() + unit * words, words);
+            }
+        }
+
+        result.valid = true;
+        return result;
+    }
+}
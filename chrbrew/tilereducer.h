@@ -0,0 +1,50 @@
+#ifndef TILEREDUCER_H
+#define TILEREDUCER_H
+
+#include <QtGui>
+
+namespace chrbrew
+{
+    // Lossy reduction of a sheet to a tile budget: the closest pair of distinct tiles is merged,
+    // over and over, until few enough remain. Units are single tiles, or top/bottom pairs for 8x16 cells.
+    class TileReducer
+    {
+        public:
+            struct Result
+            {
+                bool valid;
+                QString error;
+                // The surviving units, in order of first use.
+                QByteArray chr;
+                // The sheet with every cell replaced by its surviving unit.
+                QByteArray sheet;
+                // Surviving unit for each cell of the sheet.
+                QVector<int> map;
+                QVector<bool> changed;
+                int uniqueUnits;
+                int mergedUnits;
+                // Sum over changed cells of their distance from the original.
+                qint64 totalDistance;
+            };
+
+            TileReducer(const QByteArray& chr, int unitBytes);
+
+            // Distance is the sum over pixels of the difference between their 2-bit shades.
+            static int distance(const quint64* a, const quint64* b, int words);
+
+            Result reduce(int budget) const;
+
+            // The cell map saved next to a reduced CHR, so the sheet can be rebuilt from the surviving units:
+            // one byte per cell when there are at most 256 units, otherwise two bytes, little-endian.
+            static QString mapFilename(const QString& chrFilename);
+            static QByteArray encodeMap(const QVector<int>& map, int units);
+
+        private:
+            struct Index;
+
+            QByteArray chr;
+            int unitBytes;
+    };
+}
+
+#endif
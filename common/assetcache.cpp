@@ -0,0 +1,172 @@
+#include "assetcache.h"
+#include "atomicfile.h"
+
+namespace overbrew
+{
+    namespace
+    {
+        const quint32 MAGIC = 0x4F424331; // "OBC1"
+        const quint32 VERSION = 2;
+    }
+
+    AssetCache::AssetCache(qint64 limit)
+        : dir(QDir::home().filePath(".overbrew/cache")), limit(limit)
+    {
+        dir.mkpath(".");
+    }
+
+    QByteArray AssetCache::key(const QByteArray& contents, const QString& options)
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(contents);
+        hash.addData(options.toUtf8());
+        hash.addData(QByteArray::number(VERSION));
+        return hash.result().toHex();
+    }
+
+    QByteArray AssetCache::sheetKey(const QByteArray& chr, int cellTiles)
+    {
+        return key(chr, QString("chr;cellTiles=%1").arg(cellTiles));
+    }
+
+    bool AssetCache::load(const QByteArray& key, Entry* entry) const
+    {
+        QFile file(path(key));
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_4_6);
+
+        quint32 magic, version;
+        stream >> magic >> version;
+        if(magic != MAGIC || version != VERSION)
+        {
+            return false;
+        }
+
+        entry->image = readImage(stream);
+        stream >> entry->conversions;
+        if(stream.status() != QDataStream::Ok || entry->image.isNull())
+        {
+            return false;
+        }
+
+        file.close();
+
+        // Rewrite the first byte so the modification time tracks the last use, for LRU eviction.
+        // This is best effort: a read-only cache still serves hits, it just can't track them.
+        if(file.open(QIODevice::ReadWrite))
+        {
+            char first;
+            if(file.getChar(&first) && file.seek(0))
+            {
+                file.putChar(first);
+            }
+        }
+        return true;
+    }
+
+    bool AssetCache::store(const QByteArray& key, const Entry& entry)
+    {
+        QByteArray bytes;
+        QDataStream stream(&bytes, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_6);
+        stream << MAGIC << VERSION;
+        writeImage(stream, entry.image);
+        stream << entry.conversions;
+
+        // Swapped in whole, so a reader never sees half an entry.
+        AtomicFile file(path(key));
+        if(!file.open())
+        {
+            return false;
+        }
+        file.write(bytes);
+        if(!file.commit())
+        {
+            return false;
+        }
+
+        evict();
+        return true;
+    }
+
+    void AssetCache::writeImage(QDataStream& stream, const QImage& image)
+    {
+        // Indexed pixels are packed as tightly as the color count allows, then deflated.
+        int bits = image.colorCount() <= 4 ? 2 : image.colorCount() <= 16 ? 4 : 8;
+        int w = image.width();
+        int h = image.height();
+        int perByte = 8 / bits;
+        int stride = (w + perByte - 1) / perByte;
+
+        QByteArray pixels(stride * h, '\0');
+        for(int y = 0; y != h; ++y)
+        {
+            auto line = image.constScanLine(y);
+            auto dest = reinterpret_cast<uchar*>(pixels.data()) + y * stride;
+            for(int x = 0; x != w; ++x)
+            {
+                dest[x / perByte] |= line[x] << ((x % perByte) * bits);
+            }
+        }
+
+        stream << qint32(w) << qint32(h) << qint32(bits) << image.colorTable() << qCompress(pixels, 1);
+    }
+
+    QImage AssetCache::readImage(QDataStream& stream)
+    {
+        qint32 w, h, bits;
+        QVector<QRgb> colors;
+        QByteArray compressed;
+        stream >> w >> h >> bits >> colors >> compressed;
+        if(stream.status() != QDataStream::Ok || w <= 0 || h <= 0 || (bits != 2 && bits != 4 && bits != 8))
+        {
+            return QImage();
+        }
+
+        int perByte = 8 / bits;
+        int stride = (w + perByte - 1) / perByte;
+        int mask = (1 << bits) - 1;
+        QByteArray pixels(qUncompress(compressed));
+        if(pixels.size() != stride * h)
+        {
+            return QImage();
+        }
+
+        QImage image(w, h, QImage::Format_Indexed8);
+        image.setColorTable(colors);
+        for(int y = 0; y != h; ++y)
+        {
+            auto source = reinterpret_cast<const uchar*>(pixels.constData()) + y * stride;
+            auto line = image.scanLine(y);
+            for(int x = 0; x != w; ++x)
+            {
+                line[x] = (source[x / perByte] >> ((x % perByte) * bits)) & mask;
+            }
+        }
+        return image;
+    }
+
+    QString AssetCache::path(const QByteArray& key) const
+    {
+        return dir.filePath(QString::fromLatin1(key) + ".obc");
+    }
+
+    void AssetCache::evict()
+    {
+        // Newest first: keep files until the limit is reached, then drop the rest.
+        qint64 total = 0;
+        foreach(const QFileInfo& info, dir.entryInfoList(QStringList("*.obc"), QDir::Files, QDir::Time))
+        {
+            total += info.size();
+            if(total > limit)
+            {
+                QFile::remove(info.filePath());
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include <QtGui>
+
+namespace overbrew
+{
+    // On-disk cache of decoded assets, shared by all the tools and keyed by a hash of the
+    // source file's contents plus whatever options affect decoding.
+    class AssetCache
+    {
+        public:
+            struct Entry
+            {
+                QImage image;
+                QList<int> conversions;
+            };
+
+            static const qint64 DEFAULT_LIMIT = 64 * 1024 * 1024;
+
+            explicit AssetCache(qint64 limit = DEFAULT_LIMIT);
+
+            static QByteArray key(const QByteArray& contents, const QString& options);
+
+            // A character set decoded to an indexed sheet depends only on its tiles and cell height,
+            // so every tool shares one entry per layout.
+            static QByteArray sheetKey(const QByteArray& chr, int cellTiles);
+
+            bool load(const QByteArray& key, Entry* entry) const;
+            bool store(const QByteArray& key, const Entry& entry);
+
+        private:
+            static void writeImage(QDataStream& stream, const QImage& image);
+            static QImage readImage(QDataStream& stream);
+
+            QString path(const QByteArray& key) const;
+            void evict();
+
+            QDir dir;
+            qint64 limit;
+    };
+}
+
+#endif
@@ -0,0 +1,279 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "atomicfile.h"
+
+namespace overbrew
+{
+    namespace
+    {
+        // Pushes everything written so far to the disk, so a rename after it can't expose a file with holes.
+        bool syncToDisk(QFile* file)
+        {
+            if(!file->flush())
+            {
+                return false;
+            }
+#ifdef Q_OS_WIN
+            return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file->handle()))) != 0;
+#else
+            return ::fsync(file->handle()) == 0;
+#endif
+        }
+    }
+
+    AtomicFile::AtomicFile(const QString& filename, Mode mode)
+        : target(filename),
+        mode(mode),
+        temporary(filename + ".XXXXXX"),
+        used(0),
+        finished(false),
+        pages(0)
+    {
+        // Each instance gets its own temporary next to the target, so concurrent saves of one file can't share it.
+        temporary.setAutoRemove(false);
+    }
+
+    AtomicFile::~AtomicFile()
+    {
+        discard();
+    }
+
+    bool AtomicFile::open()
+    {
+        if(!temporary.open())
+        {
+            error = QObject::tr("Failed to open a temporary file next to '%1' for writing").arg(target);
+            return false;
+        }
+
+        // Temporary files are private to the owner; the output should read like any other saved file.
+        QFileInfo info(target);
+        temporary.setPermissions(info.exists() ? info.permissions() : QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+        buffer.resize(BUFFER_BYTES);
+        used = 0;
+        return true;
+    }
+
+    void AtomicFile::write(const char* data, qint64 size)
+    {
+        while(size > 0 && error.isEmpty())
+        {
+            if(used == BUFFER_BYTES && !flush())
+            {
+                return;
+            }
+            int count = int(qMin<qint64>(size, BUFFER_BYTES - used));
+            memcpy(buffer.data() + used, data, count);
+            used += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    void AtomicFile::write(const QByteArray& data)
+    {
+        write(data.constData(), data.size());
+    }
+
+    void AtomicFile::putChar(char c)
+    {
+        if(!error.isEmpty() || (used == BUFFER_BYTES && !flush()))
+        {
+            return;
+        }
+        buffer[used++] = c;
+    }
+
+    bool AtomicFile::flush()
+    {
+        if(error.isEmpty() && used && temporary.write(buffer.constData(), used) != used)
+        {
+            error = QObject::tr("Failed to write '%1': %2").arg(temporary.fileName()).arg(temporary.errorString());
+        }
+        used = 0;
+        return error.isEmpty();
+    }
+
+    bool AtomicFile::finish()
+    {
+        if(!temporary.isOpen())
+        {
+            if(error.isEmpty())
+            {
+                error = QObject::tr("'%1' was never opened").arg(target);
+            }
+            return false;
+        }
+
+        if(flush() && !syncToDisk(&temporary))
+        {
+            error = QObject::tr("Failed to write '%1' to disk: %2").arg(temporary.fileName()).arg(temporary.errorString());
+        }
+        temporary.close();
+        if(!error.isEmpty())
+        {
+            temporary.remove();
+            return false;
+        }
+        finished = true;
+        return true;
+    }
+
+    bool AtomicFile::commit()
+    {
+        if(!finished && !finish())
+        {
+            return false;
+        }
+
+        // From here the temporary file belongs to the target, or is kept when the swap fails.
+        finished = false;
+        QFileInfo info(target);
+        if(mode == Patch && info.exists() && info.size() == temporary.size())
+        {
+            return patch();
+        }
+        return replace();
+    }
+
+    void AtomicFile::discard()
+    {
+        if(temporary.isOpen() || finished)
+        {
+            temporary.close();
+            temporary.remove();
+            finished = false;
+        }
+    }
+
+    bool AtomicFile::writeFiles(const QList<QPair<QString, QByteArray> >& files, QString* error)
+    {
+        QList<QSharedPointer<AtomicFile> > outputs;
+        for(int i = 0, count = files.count(); i != count; ++i)
+        {
+            QSharedPointer<AtomicFile> output(new AtomicFile(files[i].first));
+            if(!output->open())
+            {
+                *error = output->errorString();
+                return false;
+            }
+            output->write(files[i].second);
+            if(!output->finish())
+            {
+                *error = output->errorString();
+                return false;
+            }
+            outputs.append(output);
+        }
+        foreach(const QSharedPointer<AtomicFile>& output, outputs)
+        {
+            if(!output->commit())
+            {
+                *error = output->errorString();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool AtomicFile::replace()
+    {
+        pages = int((temporary.size() + PAGE_BYTES - 1) / PAGE_BYTES);
+
+        // The target is swapped in one step, so it is always either the old or the new output.
+        // On failure the temporary file is kept, since it may be the only copy of the new output.
+        auto source = temporary.fileName();
+#ifdef Q_OS_WIN
+        bool renamed = MoveFileExW(
+            reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(source).utf16()),
+            reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(target).utf16()),
+            MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+        QString reason = renamed ? QString() : QString("error %1").arg(GetLastError());
+#else
+        bool renamed = ::rename(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0;
+        QString reason = renamed ? QString() : QString::fromLocal8Bit(strerror(errno));
+#endif
+        if(!renamed)
+        {
+            error = QObject::tr("Failed to replace '%1' (the new output is kept in '%2'): %3").arg(target).arg(source).arg(reason);
+            return false;
+        }
+        return true;
+    }
+
+    bool AtomicFile::patch()
+    {
+        QFile written(temporary.fileName());
+        QFile existing(target);
+        if(!written.open(QIODevice::ReadOnly) || !existing.open(QIODevice::ReadOnly))
+        {
+            written.close();
+            return replace();
+        }
+
+        // Find the changed pages first, so nothing is touched when the output is the same.
+        QList<qint64> changed;
+        for(qint64 offset = 0, size = written.size(); offset < size; offset += PAGE_BYTES)
+        {
+            if(written.read(PAGE_BYTES) != existing.read(PAGE_BYTES))
+            {
+                changed.append(offset);
+            }
+        }
+        existing.close();
+
+        pages = 0;
+        if(!changed.isEmpty())
+        {
+            if(!existing.open(QIODevice::ReadWrite))
+            {
+                written.close();
+                return replace();
+            }
+            foreach(qint64 offset, changed)
+            {
+                written.seek(offset);
+                existing.seek(offset);
+                auto page = written.read(PAGE_BYTES);
+                if(existing.write(page) != page.size())
+                {
+                    // The complete output is still in the temporary file, so fall back to swapping it in.
+                    existing.close();
+                    written.close();
+                    return replace();
+                }
+                ++pages;
+            }
+            if(!syncToDisk(&existing))
+            {
+                existing.close();
+                written.close();
+                return replace();
+            }
+            existing.close();
+        }
+
+        written.close();
+        written.remove();
+        return true;
+    }
+
+    QString AtomicFile::errorString() const
+    {
+        return error;
+    }
+
+    int AtomicFile::pagesWritten() const
+    {
+        return pages;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <QtGui>
+
+namespace overbrew
+{
+    // Output written through a bounded buffer to a temporary file, which only replaces the target on commit,
+    // so a failed or interrupted save leaves the old file intact.
+    class AtomicFile
+    {
+        public:
+            enum Mode
+            {
+                // Rename the finished file over the target.
+                Replace,
+                // Compare with the target and rewrite only the pages that differ. Identical output leaves
+                // the target (and its timestamp) untouched. A change in size falls back to Replace.
+                Patch
+            };
+
+            static const int PAGE_BYTES = 4096;
+            static const int BUFFER_BYTES = 64 * 1024;
+
+            explicit AtomicFile(const QString& filename, Mode mode = Replace);
+            ~AtomicFile();
+
+            bool open();
+            void write(const char* data, qint64 size);
+            void write(const QByteArray& data);
+            void putChar(char c);
+
+            // Writes out and syncs the temporary file, leaving only the swap for commit.
+            bool finish();
+
+            // Write errors are remembered and reported here.
+            bool commit();
+            void discard();
+
+            // Saves outputs that belong together: every file is finished before any target is replaced,
+            // so a failed write leaves all of the old outputs in place.
+            static bool writeFiles(const QList<QPair<QString, QByteArray> >& files, QString* error);
+
+            QString errorString() const;
+            int pagesWritten() const;
+
+        private:
+            bool flush();
+            bool replace();
+            bool patch();
+
+            QString target;
+            Mode mode;
+            QTemporaryFile temporary;
+            QByteArray buffer;
+            int used;
+            bool finished;
+            QString error;
+            int pages;
+    };
+}
+
+#endif
@@ -0,0 +1,13 @@
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/assetcache.cpp \
+    $$PWD/atomicfile.cpp \
+    $$PWD/memorytracker.cpp \
+    $$PWD/sharedchr.cpp \
+    $$PWD/tilestore.cpp
+HEADERS += $$PWD/assetcache.h \
+    $$PWD/atomicfile.h \
+    $$PWD/memorytracker.h \
+    $$PWD/sharedchr.h \
+    $$PWD/tilestore.h
@@ -0,0 +1,94 @@
+#include "memorytracker.h"
+
+namespace overbrew
+{
+    namespace
+    {
+        struct Registry
+        {
+            QMutex mutex;
+            QMap<QString, qint64> sizes;
+        };
+
+        Registry& registry()
+        {
+            static Registry instance;
+            return instance;
+        }
+    }
+
+    void MemoryTracker::set(const QString& name, qint64 bytes)
+    {
+        auto& r = registry();
+        QMutexLocker lock(&r.mutex);
+        r.sizes.insert(name, bytes);
+    }
+
+    void MemoryTracker::remove(const QString& name)
+    {
+        auto& r = registry();
+        QMutexLocker lock(&r.mutex);
+        r.sizes.remove(name);
+    }
+
+    void MemoryTracker::removeAll(const QString& prefix)
+    {
+        auto& r = registry();
+        QMutexLocker lock(&r.mutex);
+        auto it = r.sizes.lowerBound(prefix);
+        while(it != r.sizes.end() && it.key().startsWith(prefix))
+        {
+            it = r.sizes.erase(it);
+        }
+    }
+
+    QList<QPair<QString, qint64> > MemoryTracker::entries()
+    {
+        auto& r = registry();
+        QMutexLocker lock(&r.mutex);
+        QList<QPair<QString, qint64> > result;
+        for(auto it = r.sizes.constBegin(); it != r.sizes.constEnd(); ++it)
+        {
+            result.append(qMakePair(it.key(), it.value()));
+        }
+        return result;
+    }
+
+    qint64 MemoryTracker::total()
+    {
+        qint64 sum = 0;
+        foreach(const auto& entry, entries())
+        {
+            sum += entry.second;
+        }
+        return sum;
+    }
+
+    QString MemoryTracker::report()
+    {
+        QString text;
+        qint64 sum = 0;
+        foreach(const auto& entry, entries())
+        {
+            text += QString("%1: %2 KB\n").arg(entry.first).arg((entry.second + 1023) / 1024);
+            sum += entry.second;
+        }
+        text += QObject::tr("Total tracked: %1 KB\n").arg((sum + 1023) / 1024);
+        return text;
+    }
+
+    qint64 MemoryTracker::bytes(const QImage& image)
+    {
+        return image.isNull() ? 0 : qint64(image.byteCount()) + image.colorCount() * sizeof(QRgb);
+    }
+
+    qint64 MemoryTracker::bytes(const QPixmap* pixmap)
+    {
+        return pixmap && !pixmap->isNull() ? qint64(pixmap->width()) * pixmap->height() * pixmap->depth() / 8 : 0;
+    }
+
+    qint64 MemoryTracker::bytes(const QByteArray& data)
+    {
+        return data.capacity();
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <QtGui>
+
+namespace overbrew
+{
+    // A process-wide tally of the big buffers each tool holds, by name, for the debug panel and headless reports.
+    // Owners update their entries when a buffer changes and remove them when it goes away.
+    class MemoryTracker
+    {
+        public:
+            // Rough cost of one widget (object, private data, style and palette), since Qt doesn't expose it.
+            static const int WIDGET_BYTES = 1024;
+
+            static void set(const QString& name, qint64 bytes);
+            static void remove(const QString& name);
+            static void removeAll(const QString& prefix);
+
+            static QList<QPair<QString, qint64> > entries();
+            static qint64 total();
+            static QString report();
+
+            static qint64 bytes(const QImage& image);
+            static qint64 bytes(const QPixmap* pixmap);
+            static qint64 bytes(const QByteArray& data);
+    };
+}
+
+#endif
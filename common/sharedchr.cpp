@@ -0,0 +1,130 @@
+#include <cstring>
+
+#include "sharedchr.h"
+
+namespace overbrew
+{
+    namespace
+    {
+        const quint32 MAGIC = 0x52484331; // "1CHR"
+
+        QString segmentKey()
+        {
+            auto user = QString::fromLocal8Bit(qgetenv("USER"));
+            if(user.isEmpty())
+            {
+                user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+            }
+            return QString("overbrew-chr-%1").arg(user);
+        }
+    }
+
+    SharedCHR::SharedCHR()
+        : memory(segmentKey())
+    {
+    }
+
+    int SharedCHR::segmentSize()
+    {
+        // Header, then a change stamp per tile, then the tiles.
+        return sizeof(Header) + MAX_TILES * sizeof(quint32) + MAX_TILES * TILE_BYTES;
+    }
+
+    bool SharedCHR::attach(bool create)
+    {
+        if(memory.isAttached())
+        {
+            return true;
+        }
+        if(create && memory.create(segmentSize()))
+        {
+            memory.lock();
+            memset(memory.data(), 0, segmentSize());
+            auto header = static_cast<Header*>(memory.data());
+            header->magic = MAGIC;
+            memory.unlock();
+            return true;
+        }
+        return memory.attach() && memory.size() >= segmentSize();
+    }
+
+    bool SharedCHR::publish(const QByteArray& chr)
+    {
+        if(!attach(true))
+        {
+            return false;
+        }
+
+        int tiles = qMin(chr.size() / TILE_BYTES, int(MAX_TILES));
+        memory.lock();
+        auto header = static_cast<Header*>(memory.data());
+        auto stamps = reinterpret_cast<quint32*>(header + 1);
+        auto data = reinterpret_cast<char*>(stamps + MAX_TILES);
+
+        quint32 next = header->sequence + 1;
+        bool dirty = header->tiles != quint32(tiles);
+        for(int t = 0; t != tiles; ++t)
+        {
+            auto source = chr.constData() + t * TILE_BYTES;
+            auto dest = data + t * TILE_BYTES;
+            if(memcmp(source, dest, TILE_BYTES))
+            {
+                memcpy(dest, source, TILE_BYTES);
+                stamps[t] = next;
+                dirty = true;
+            }
+        }
+        if(dirty)
+        {
+            header->tiles = tiles;
+            header->sequence = next;
+        }
+        memory.unlock();
+        return true;
+    }
+
+    bool SharedCHR::poll(quint32* sequence, QByteArray* chr, QList<int>* changed)
+    {
+        changed->clear();
+        if(!attach(false))
+        {
+            return false;
+        }
+
+        memory.lock();
+        auto header = static_cast<const Header*>(memory.constData());
+        auto stamps = reinterpret_cast<const quint32*>(header + 1);
+        auto data = reinterpret_cast<const char*>(stamps + MAX_TILES);
+        if(header->magic != MAGIC || header->sequence == *sequence || !header->tiles)
+        {
+            memory.unlock();
+            return false;
+        }
+
+        int tiles = header->tiles;
+        bool full = header->sequence < *sequence || chr->size() != tiles * TILE_BYTES;
+        if(full)
+        {
+            *chr = QByteArray(data, tiles * TILE_BYTES);
+            for(int t = 0; t != tiles; ++t)
+            {
+                changed->append(t);
+            }
+        }
+        else
+        {
+            auto dest = chr->data();
+            for(int t = 0; t != tiles; ++t)
+            {
+                if(stamps[t] > *sequence)
+                {
+                    memcpy(dest + t * TILE_BYTES, data + t * TILE_BYTES, TILE_BYTES);
+                    changed->append(t);
+                }
+            }
+        }
+        *sequence = header->sequence;
+        memory.unlock();
+        return true;
+    }
+}
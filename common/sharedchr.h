@@ -0,0 +1,42 @@
+#ifndef SHAREDCHR_H
+#define SHAREDCHR_H
+
+#include <QtGui>
+
+namespace overbrew
+{
+    // A CHR published through shared memory, so one tool's edits reach the others without touching files.
+    // Each tile carries the sequence number of its last change; a reader copies only tiles newer than the
+    // sequence it last saw.
+    class SharedCHR
+    {
+        public:
+            static const int MAX_TILES = 4096;
+            static const int TILE_BYTES = 16;
+
+            SharedCHR();
+
+            // Creates the segment if needed and writes the tiles that differ.
+            bool publish(const QByteArray& chr);
+
+            // Brings chr up to date if anything was published since *sequence, listing the tiles that changed.
+            // When the tile count changes (or a new publisher started over), every tile is listed.
+            bool poll(quint32* sequence, QByteArray* chr, QList<int>* changed);
+
+        private:
+            struct Header
+            {
+                quint32 magic;
+                quint32 sequence;
+                quint32 tiles;
+                quint32 reserved;
+            };
+
+            static int segmentSize();
+            bool attach(bool create);
+
+            QSharedMemory memory;
+    };
+}
+
+#endif
@@ -0,0 +1,230 @@
+#include <cstring>
+
+#include "tilestore.h"
+
+namespace overbrew
+{
+    namespace
+    {
+        struct Tables
+        {
+            // Bits reversed, for horizontal flips.
+            quint8 reverse[256];
+
+            // Each bit of a plane byte spread into its own byte, leftmost pixel first in memory.
+            quint64 spread[256];
+
+            Tables()
+            {
+                for(int value = 0; value != 256; ++value)
+                {
+                    quint8 bits[8];
+                    int reversed = 0;
+                    for(int i = 0; i != 8; ++i)
+                    {
+                        bits[i] = (value >> (7 - i)) & 1;
+                        reversed |= ((value >> i) & 1) << (7 - i);
+                    }
+                    reverse[value] = reversed;
+                    std::memcpy(&spread[value], bits, sizeof(bits));
+                }
+            }
+        };
+
+        const Tables tables;
+    }
+
+    TileStore::TileStore()
+    {
+    }
+
+    TileStore::TileStore(const QByteArray& bytes)
+        : data(bytes)
+    {
+    }
+
+    int TileStore::count() const
+    {
+        return data.size() / BYTES;
+    }
+
+    bool TileStore::isEmpty() const
+    {
+        return data.isEmpty();
+    }
+
+    const QByteArray& TileStore::bytes() const
+    {
+        return data;
+    }
+
+    QByteArray TileStore::tile(int index) const
+    {
+        if(index >= 0 && index < count())
+        {
+            return data.mid(index * BYTES, BYTES);
+        }
+        return QByteArray(BYTES, '\0');
+    }
+
+    void TileStore::append(const QByteArray& tile)
+    {
+        data.append(tile);
+    }
+
+    void TileStore::flip(const char* source, char* dest, int rows, int flips)
+    {
+        for(int j = 0; j != rows; ++j)
+        {
+            int from = flips & VerticalFlip ? rows - 1 - j : j;
+            quint8 low = source[from * 2];
+            quint8 high = source[from * 2 + 1];
+            if(flips & HorizontalFlip)
+            {
+                low = tables.reverse[low];
+                high = tables.reverse[high];
+            }
+            dest[j * 2] = low;
+            dest[j * 2 + 1] = high;
+        }
+    }
+
+    bool TileStore::equals(const char* a, const char* b, int rows)
+    {
+        return std::memcmp(a, b, rows * 2) == 0;
+    }
+
+    uint TileStore::hash(const char* tile, int rows)
+    {
+        return qHash(QByteArray::fromRawData(tile, rows * 2));
+    }
+
+    quint8 TileStore::colorMask(quint8 low, quint8 high, int color)
+    {
+        return (color & 1 ? low : ~low) & (color & 2 ? high : ~high);
+    }
+
+    void TileStore::renderRow(quint8 low, quint8 high, const QRgb* colors, QRgb* dest, bool transparent)
+    {
+        quint64 indices = tables.spread[low] | tables.spread[high] << 1;
+        quint8 pixels[8];
+        std::memcpy(pixels, &indices, sizeof(pixels));
+        for(int i = 0; i != WIDTH; ++i)
+        {
+            if(pixels[i] || !transparent)
+            {
+                dest[i] = colors[pixels[i]];
+            }
+        }
+    }
+
+    void TileStore::indexRow(quint8 low, quint8 high, uchar* dest, bool transparent)
+    {
+        quint64 indices = tables.spread[low] | tables.spread[high] << 1;
+        if(transparent)
+        {
+            quint8 pixels[8];
+            std::memcpy(pixels, &indices, sizeof(pixels));
+            for(int i = 0; i != WIDTH; ++i)
+            {
+                if(pixels[i])
+                {
+                    dest[i] = pixels[i];
+                }
+            }
+        }
+        else
+        {
+            std::memcpy(dest, &indices, WIDTH);
+        }
+    }
+
+    void TileStore::renderTile(int index, int flips, const QRgb* colors, QImage* target, int x, int y, bool transparent) const
+    {
+        if(index < 0 || index >= count())
+        {
+            return;
+        }
+
+        char tile[BYTES];
+        flip(data.constData() + index * BYTES, tile, HEIGHT, flips);
+        bool indexed = target->format() == QImage::Format_Indexed8;
+        for(int j = 0; j != HEIGHT; ++j)
+        {
+            if(y + j < 0 || y + j >= target->height() || x < 0 || x + WIDTH > target->width())
+            {
+                continue;
+            }
+            if(indexed)
+            {
+                indexRow(tile[j * 2], tile[j * 2 + 1], target->scanLine(y + j) + x, transparent);
+            }
+            else
+            {
+                auto dest = reinterpret_cast<QRgb*>(target->scanLine(y + j)) + x;
+                renderRow(tile[j * 2], tile[j * 2 + 1], colors, dest, transparent);
+            }
+        }
+    }
+
+    void TileStore::sheetLayout(int tiles, int cellTiles, int* columns, int* rows)
+    {
+        int cells = (tiles + cellTiles - 1) / cellTiles;
+        *columns = 0;
+        *rows = 0;
+        for(int i = 16; i != 1; i /= 2)
+        {
+            if(cells % i == 0)
+            {
+                if(i >= 8)
+                {
+                    *columns = i;
+                    *rows = cells / i;
+                }
+                else
+                {
+                    *rows = i;
+                    *columns = cells / i;
+                }
+                break;
+            }
+        }
+        if(*columns == 0)
+        {
+            *columns = cells;
+            *rows = 1;
+        }
+    }
+
+    QImage TileStore::render(int columns, int rows, int cellTiles, const QRgb* colors) const
+    {
+        QImage image(columns * WIDTH, rows * cellTiles * HEIGHT, QImage::Format_RGB32);
+        image.fill(colors[0]);
+        renderCells(&image, columns, rows, cellTiles, colors);
+        return image;
+    }
+
+    QImage TileStore::renderIndexed(int columns, int rows, int cellTiles) const
+    {
+        QImage image(columns * WIDTH, rows * cellTiles * HEIGHT, QImage::Format_Indexed8);
+        image.setColorCount(4);
+        image.fill(0);
+        renderCells(&image, columns, rows, cellTiles, 0);
+        return image;
+    }
+
+    void TileStore::renderCells(QImage* image, int columns, int rows, int cellTiles, const QRgb* colors) const
+    {
+        for(int r = 0; r != rows; ++r)
+        {
+            for(int c = 0; c != columns; ++c)
+            {
+                for(int t = 0; t != cellTiles; ++t)
+                {
+                    int index = (r * columns + c) * cellTiles + t;
+                    renderTile(index, 0, colors, image, c * WIDTH, (r * cellTiles + t) * HEIGHT, false);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef TILESTORE_H
+#define TILESTORE_H
+
+#include <QtGui>
+
+namespace overbrew
+{
+    // Tiles kept in their packed 2bpp form (16 bytes per 8x8 tile, a low and high plane byte per row),
+    // with row-at-a-time kernels, so views can render what they need instead of holding decoded copies.
+    class TileStore
+    {
+        public:
+            static const int WIDTH = 8;
+            static const int HEIGHT = 8;
+            static const int BYTES = 16;
+
+            enum
+            {
+                HorizontalFlip = 0x1,
+                VerticalFlip = 0x2
+            };
+
+            TileStore();
+            explicit TileStore(const QByteArray& bytes);
+
+            int count() const;
+            bool isEmpty() const;
+            const QByteArray& bytes() const;
+            QByteArray tile(int index) const;
+            void append(const QByteArray& tile);
+
+            // Kernels over raw tiles of any number of rows (8x16 pairs are 16 rows).
+            static void flip(const char* source, char* dest, int rows, int flips);
+            static bool equals(const char* a, const char* b, int rows);
+            static uint hash(const char* tile, int rows);
+
+            // The pixels of one row that have the given color, as a bitmask with the leftmost pixel in bit 7.
+            static quint8 colorMask(quint8 low, quint8 high, int color);
+
+            // Writes one row as 8 colors; color 0 is skipped when transparent.
+            static void renderRow(quint8 low, quint8 high, const QRgb* colors, QRgb* dest, bool transparent);
+
+            // Writes one row as 8 color indices; index 0 is skipped when transparent.
+            static void indexRow(quint8 low, quint8 high, uchar* dest, bool transparent);
+
+            // Draws a tile into an RGB32 image, or as indices into an Indexed8 image (colors are then unused).
+            void renderTile(int index, int flips, const QRgb* colors, QImage* target, int x, int y, bool transparent) const;
+
+            // Picks a sheet shape for the tiles that's easy to view: 8 or 16 cells across when they divide evenly.
+            static void sheetLayout(int tiles, int cellTiles, int* columns, int* rows);
+
+            // Lays the tiles out in cells of cellTiles stacked tiles, left to right, then top to bottom.
+            QImage render(int columns, int rows, int cellTiles, const QRgb* colors) const;
+
+            // The same layout as indices, so one buffer can be shown under any number of color tables.
+            QImage renderIndexed(int columns, int rows, int cellTiles) const;
+
+        private:
+            void renderCells(QImage* image, int columns, int rows, int cellTiles, const QRgb* colors) const;
+
+            QByteArray data;
+    };
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include "animationencoder.h"
+
+namespace spritebrew
+{
+    namespace
+    {
+        const int MAX_FRAMES = 255;
+        const int MAX_OFFSET = 0xFFFF;
+
+        bool fitsNibble(int value)
+        {
+            return value >= -8 && value <= 7;
+        }
+    }
+
+    AnimationEncoder::AnimationEncoder(const QVector<Animation>& animations)
+        : animations(animations)
+    {
+    }
+
+    QString AnimationEncoder::name(Encoding encoding)
+    {
+        switch(encoding)
+        {
+            case Raw: return QObject::tr("raw frames"); break;
+            case PreviousDelta: return QObject::tr("deltas from previous frame"); break;
+            case KeyframeDelta: return QObject::tr("deltas from first frame"); break;
+            default: return QString(); break;
+        }
+    }
+
+    AnimationEncoder::Result AnimationEncoder::encode() const
+    {
+        Result result;
+        result.valid = false;
+        result.rawBytes = 0;
+        result.bytes = 0;
+
+        // A count, then a little-endian offset per animation, then the animations.
+        int count = animations.count();
+        QByteArray table;
+        QByteArray body;
+        table.append(char(count));
+        if(count > 255)
+        {
+            result.error = QObject::tr("%1 animations can't be exported; the table holds at most 255.").arg(count);
+            return result;
+        }
+
+        foreach(const Animation& animation, animations)
+        {
+            if(animation.frames.count() > MAX_FRAMES)
+            {
+                result.error = QObject::tr("'%1' has %2 frames, but at most %3 can be exported.")
+                    .arg(animation.name).arg(animation.frames.count()).arg(MAX_FRAMES);
+                return result;
+            }
+            foreach(const Metasprite& frame, animation.frames)
+            {
+                if(frame.parts.count() > CountMask)
+                {
+                    result.error = QObject::tr("'%1' has a frame with %2 parts, but at most %3 can be exported.")
+                        .arg(animation.name).arg(frame.parts.count()).arg(int(CountMask));
+                    return result;
+                }
+            }
+
+            // Ties go to the simpler encoding.
+            QByteArray best;
+            Stats stats;
+            stats.name = animation.name;
+            stats.encoding = Raw;
+            for(int e = 0; e != EncodingCount; ++e)
+            {
+                auto frames = encodeFrames(animation, Encoding(e));
+                if(e == Raw)
+                {
+                    stats.rawBytes = frames.size();
+                }
+                if(best.isEmpty() || frames.size() < best.size())
+                {
+                    best = frames;
+                    stats.encoding = Encoding(e);
+                }
+            }
+
+            // Encoding, frame count, the banks the animation needs, then its frames.
+            QByteArray encoded;
+            encoded.append(char(stats.encoding));
+            encoded.append(char(animation.frames.count()));
+            encoded.append(char(animation.banks.count()));
+            foreach(int bank, animation.banks)
+            {
+                encoded.append(char(bank));
+            }
+            encoded.append(best);
+
+            int offset = 1 + count * 2 + body.size();
+            if(offset > MAX_OFFSET)
+            {
+                result.error = QObject::tr("The animations need more than %1 bytes, past what the offset table can address.").arg(MAX_OFFSET);
+                return result;
+            }
+            table.append(char(offset & 0xFF));
+            table.append(char(offset >> 8));
+            body.append(encoded);
+
+            stats.rawBytes += encoded.size() - best.size();
+            stats.bytes = encoded.size();
+            result.rawBytes += stats.rawBytes;
+            result.bytes += stats.bytes;
+            result.animations.append(stats);
+        }
+
+        result.data = table + body;
+        result.rawBytes += table.size();
+        result.bytes += table.size();
+        result.valid = true;
+        return result;
+    }
+
+    QByteArray AnimationEncoder::encodeFrames(const Animation& animation, Encoding encoding)
+    {
+        QByteArray out;
+        const Metasprite* previous = 0;
+        foreach(const Metasprite& frame, animation.frames)
+        {
+            if(encoding == Raw)
+            {
+                out.append(char(frame.parts.count()));
+                appendParts(&out, frame);
+                continue;
+            }
+
+            // Each frame is a delta when one exists and is smaller than the whole frame.
+            const Metasprite* base = encoding == PreviousDelta ? previous : (previous ? &animation.frames[0] : 0);
+            QByteArray changes;
+            if(base && base->parts.count() == frame.parts.count())
+            {
+                changes = delta(*base, frame);
+            }
+            if(!changes.isEmpty() && changes.size() < 1 + frame.parts.count() * 4)
+            {
+                out.append(changes);
+            }
+            else
+            {
+                out.append(char(KeyframeFlag | frame.parts.count()));
+                appendParts(&out, frame);
+            }
+            previous = &frame;
+        }
+        return out;
+    }
+
+    void AnimationEncoder::appendParts(QByteArray* out, const Metasprite& frame)
+    {
+        foreach(const Part& part, frame.parts)
+        {
+            out->append(char(part.y));
+            out->append(char(part.tile));
+            out->append(char(part.attributes));
+            out->append(char(part.x));
+        }
+    }
+
+    QByteArray AnimationEncoder::delta(const Metasprite& base, const Metasprite& frame)
+    {
+        QByteArray records;
+        int changed = 0;
+        for(int i = 0, end = frame.parts.count(); i != end; ++i)
+        {
+            const auto& from = base.parts[i];
+            const auto& to = frame.parts[i];
+            int dx = to.x - from.x;
+            int dy = to.y - from.y;
+
+            int flags = (dx ? XChanged : 0)
+                | (dy ? YChanged : 0)
+                | (to.tile != from.tile ? TileChanged : 0)
+                | (to.attributes != from.attributes ? AttributesChanged : 0);
+            if(!flags)
+            {
+                continue;
+            }
+            if((flags & (XChanged | YChanged)) == (XChanged | YChanged) && fitsNibble(dx) && fitsNibble(dy))
+            {
+                flags |= PackedOffsets;
+            }
+
+            records.append(char(i));
+            records.append(char(flags));
+            if(flags & PackedOffsets)
+            {
+                records.append(char(((dy & 0x0F) << 4) | (dx & 0x0F)));
+            }
+            else
+            {
+                if(flags & YChanged)
+                {
+                    records.append(char(dy));
+                }
+                if(flags & XChanged)
+                {
+                    records.append(char(dx));
+                }
+            }
+            if(flags & TileChanged)
+            {
+                records.append(char(to.tile));
+            }
+            if(flags & AttributesChanged)
+            {
+                records.append(char(to.attributes));
+            }
+            ++changed;
+        }
+
+        // A frame identical to its base is a delta with no records.
+        return char(changed) + records;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ANIMATIONENCODER_H
+#define ANIMATIONENCODER_H
+
+#include <QtGui>
+#include "metasprite.h"
+
+namespace spritebrew
+{
+    // Packs a cast of animations for the game, encoding each one as whichever of raw frames,
+    // deltas against the previous frame, or deltas against the first frame is smallest.
+    class AnimationEncoder
+    {
+        public:
+            enum Encoding
+            {
+                Raw,
+                PreviousDelta,
+                KeyframeDelta,
+                EncodingCount
+            };
+
+            // Frame headers: a keyframe's part count, or a delta's changed part count.
+            enum
+            {
+                KeyframeFlag = 0x80,
+                CountMask = 0x7F
+            };
+
+            // Delta records: a part index, these flags, then the changed Y and X, tile and attributes.
+            // Y and X are relative to the base part, and share one byte (Y in the high nibble) when both fit.
+            enum
+            {
+                XChanged = 0x01,
+                YChanged = 0x02,
+                TileChanged = 0x04,
+                AttributesChanged = 0x08,
+                PackedOffsets = 0x10
+            };
+
+            struct Stats
+            {
+                QString name;
+                Encoding encoding;
+                int rawBytes;
+                int bytes;
+            };
+
+            struct Result
+            {
+                bool valid;
+                QString error;
+                QByteArray data;
+                QVector<Stats> animations;
+                int rawBytes;
+                int bytes;
+            };
+
+            explicit AnimationEncoder(const QVector<Animation>& animations);
+
+            Result encode() const;
+
+            static QString name(Encoding encoding);
+
+        private:
+            static QByteArray encodeFrames(const Animation& animation, Encoding encoding);
+            static void appendParts(QByteArray* out, const Metasprite& frame);
+            static QByteArray delta(const Metasprite& base, const Metasprite& frame);
+
+            QVector<Animation> animations;
+    };
+}
+
+#endif
@@ -0,0 +1,455 @@
+#include <cmath>
+
+#include "bankoptimizer.h"
+#include "chrtile.h"
+#include "tilestore.h"
+
+namespace spritebrew
+{
+    using overbrew::TileStore;
+
+    namespace
+    {
+        const int OverflowPenalty = 1000;
+
+        class Random
+        {
+            public:
+                explicit Random(quint32 seed)
+                    : state(seed * 2654435761u + 1)
+                {
+                }
+
+                quint32 next()
+                {
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    return state;
+                }
+
+                double unit()
+                {
+                    return (next() >> 8) / double(1 << 24);
+                }
+
+            private:
+                quint32 state;
+        };
+    }
+
+    struct BankOptimizer::Problem
+    {
+        int tiles;
+        int banks;
+        int bankTiles;
+        int windows;
+        QVector<QVector<int> > tileAnimations;
+        QVector<QVector<int> > animationTiles;
+        QVector<int> initial;
+
+        int animationCost(int distinct) const
+        {
+            return distinct + (distinct > windows ? (distinct - windows) * OverflowPenalty : 0);
+        }
+    };
+
+    struct BankOptimizer::Chain
+    {
+        const Problem* problem;
+        quint32 seed;
+        int iterations;
+    };
+
+    struct BankOptimizer::ChainResult
+    {
+        QVector<int> bankOf;
+        int cost;
+        quint32 seed;
+    };
+
+    BankOptimizer::BankOptimizer(const QByteArray& chr, const QVector<Animation>& animations, int bankTiles)
+        : chr(chr), animations(animations), bankTiles(bankTiles)
+    {
+    }
+
+    BankOptimizer::Result BankOptimizer::optimize(int iterations) const
+    {
+        Result result;
+        result.valid = false;
+        result.animations = animations;
+
+        // Merge identical and flipped tiles, remembering how each original tile maps onto its representative.
+        // Representatives are found by hash, then compared in place.
+        QMultiHash<uint, int> uniqueIndex;
+        QVector<QByteArray> uniqueTiles;
+        auto findUnique = [&](const QByteArray& tile, uint tileHash) -> int
+        {
+            for(auto it = uniqueIndex.constFind(tileHash); it != uniqueIndex.constEnd() && it.key() == tileHash; ++it)
+            {
+                if(TileStore::equals(tile.constData(), uniqueTiles[it.value()].constData(), TileStore::HEIGHT))
+                {
+                    return it.value();
+                }
+            }
+            return -1;
+        };
+        QHash<int, QPair<int, int> > resolved;
+        QVector<QVector<int> > animationTiles(animations.count());
+        result.flippedTiles = 0;
+
+        for(int a = 0, end = animations.count(); a != end; ++a)
+        {
+            const auto& animation = animations[a];
+            QSet<int> used;
+            foreach(const Metasprite& frame, animation.frames)
+            {
+                foreach(const Part& part, frame.parts)
+                {
+                    int original = animation.chrTile(part.tile);
+                    if(!resolved.contains(original))
+                    {
+                        int flips;
+                        auto tile = ChrTile::canonical(ChrTile::tileAt(chr, original), &flips);
+                        uint tileHash = TileStore::hash(tile.constData(), TileStore::HEIGHT);
+                        int unique = findUnique(tile, tileHash);
+                        if(unique == -1)
+                        {
+                            unique = uniqueTiles.count();
+                            uniqueIndex.insert(tileHash, unique);
+                            uniqueTiles.append(tile);
+                        }
+                        else if(flips)
+                        {
+                            ++result.flippedTiles;
+                        }
+                        resolved.insert(original, qMakePair(unique, flips));
+                    }
+                    used.insert(resolved[original].first);
+                }
+            }
+            animationTiles[a] = used.toList().toVector();
+            qSort(animationTiles[a]);
+        }
+
+        result.usedTiles = resolved.count();
+        result.uniqueTiles = uniqueTiles.count();
+        if(resolved.isEmpty())
+        {
+            result.error = QObject::tr("No part uses a tile from the character set, so there is nothing to pack.");
+            return result;
+        }
+
+        // Tiles no part uses are kept as they are, merged like the rest, to fill in around the packed banks.
+        // Their representatives go after the used ones, so only the used tiles are packed.
+        QVector<QByteArray> unusedTiles;
+        for(int i = 0, end = chr.size() / ChrTile::BYTES; i != end; ++i)
+        {
+            if(!resolved.contains(i))
+            {
+                int flips;
+                auto tile = ChrTile::tileAt(chr, i);
+                auto key = ChrTile::canonical(tile, &flips);
+                uint tileHash = TileStore::hash(key.constData(), TileStore::HEIGHT);
+                if(findUnique(key, tileHash) == -1)
+                {
+                    uniqueIndex.insert(tileHash, uniqueTiles.count());
+                    uniqueTiles.append(key);
+                    unusedTiles.append(tile);
+                }
+            }
+        }
+        result.keptTiles = unusedTiles.count();
+
+        Problem problem;
+        problem.tiles = result.uniqueTiles;
+        problem.bankTiles = bankTiles;
+        problem.banks = qMax((problem.tiles + bankTiles - 1) / bankTiles, 1);
+        problem.windows = 256 / bankTiles;
+        problem.animationTiles = animationTiles;
+        problem.tileAnimations.resize(problem.tiles);
+        for(int a = 0, end = animationTiles.count(); a != end; ++a)
+        {
+            foreach(int t, animationTiles[a])
+            {
+                problem.tileAnimations[t].append(a);
+            }
+        }
+
+        // Naive layout: tiles in first-use order.
+        QVector<int> naive(problem.tiles);
+        for(int t = 0; t != problem.tiles; ++t)
+        {
+            naive[t] = t / bankTiles;
+        }
+        result.naiveSwitches = cost(problem, naive, false);
+
+        // Greedy start: place the largest animations first, next to tiles they already share.
+        QVector<int> order(animationTiles.count());
+        for(int a = 0, end = order.count(); a != end; ++a)
+        {
+            order[a] = a;
+        }
+        qStableSort(order.begin(), order.end(),
+            [&](int a, int b)
+            {
+                return animationTiles[a].count() > animationTiles[b].count();
+            }
+        );
+
+        problem.initial.fill(-1, problem.tiles);
+        QVector<int> fill(problem.banks, 0);
+        foreach(int a, order)
+        {
+            QVector<int> affinity(problem.banks, 0);
+            QVector<int> pending;
+            foreach(int t, animationTiles[a])
+            {
+                if(problem.initial[t] == -1)
+                {
+                    pending.append(t);
+                }
+                else
+                {
+                    ++affinity[problem.initial[t]];
+                }
+            }
+            foreach(int t, pending)
+            {
+                int best = -1;
+                for(int b = 0; b != problem.banks; ++b)
+                {
+                    if(fill[b] < bankTiles && (best == -1 || affinity[b] > affinity[best]
+                        || (affinity[b] == affinity[best] && fill[b] > fill[best])))
+                    {
+                        best = b;
+                    }
+                }
+                problem.initial[t] = best;
+                ++fill[best];
+                ++affinity[best];
+            }
+        }
+
+        // Anneal several independent chains in parallel, keeping the best (lowest seed on ties).
+        QList<Chain> chains;
+        for(int i = 0, end = qMax(QThread::idealThreadCount(), 1) * 2; i != end; ++i)
+        {
+            Chain chain = { &problem, quint32(i), iterations };
+            chains.append(chain);
+        }
+        auto results = QtConcurrent::blockingMapped<QList<ChainResult> >(chains, &BankOptimizer::runChain);
+
+        int best = 0;
+        for(int i = 1, end = results.count(); i != end; ++i)
+        {
+            if(results[i].cost < results[best].cost || (results[i].cost == results[best].cost && results[i].seed < results[best].seed))
+            {
+                best = i;
+            }
+        }
+        const auto& bankOf = results[best].bankOf;
+        result.switches = cost(problem, bankOf, false);
+
+        // Lay out the banks, keeping first-use order within each bank.
+        QVector<int> newIndex(problem.tiles);
+        fill.fill(0);
+        result.chr = QByteArray(problem.banks * bankTiles * ChrTile::BYTES, '\0');
+        for(int t = 0; t != problem.tiles; ++t)
+        {
+            int b = bankOf[t];
+            newIndex[t] = b * bankTiles + fill[b]++;
+            result.chr.replace(newIndex[t] * ChrTile::BYTES, ChrTile::BYTES, uniqueTiles[t]);
+        }
+
+        // Unused tiles take the free slots first, since no animation loads a bank for them, then extra banks.
+        int spare = 0;
+        foreach(const QByteArray& tile, unusedTiles)
+        {
+            while(fill[spare] == bankTiles)
+            {
+                if(++spare == fill.count())
+                {
+                    fill.append(0);
+                    result.chr.append(QByteArray(bankTiles * ChrTile::BYTES, '\0'));
+                }
+            }
+            result.chr.replace((spare * bankTiles + fill[spare]++) * ChrTile::BYTES, ChrTile::BYTES, tile);
+        }
+        result.banks = fill.count();
+
+        // Assign each animation's banks to pattern table windows and rewrite the parts.
+        for(int a = 0, end = animations.count(); a != end; ++a)
+        {
+            const auto& source = animations[a];
+            auto& animation = result.animations[a];
+
+            QVector<int> banks;
+            foreach(int t, animationTiles[a])
+            {
+                if(!banks.contains(bankOf[t]))
+                {
+                    banks.append(bankOf[t]);
+                }
+            }
+            qSort(banks);
+            if(banks.count() > problem.windows)
+            {
+                result.error = QObject::tr("'%1' needs %2 banks, but only %3 fit in the sprite pattern table.")
+                    .arg(animation.name).arg(banks.count()).arg(problem.windows);
+                return result;
+            }
+
+            animation.banks.fill(0, problem.windows);
+            for(int w = 0, count = banks.count(); w != count; ++w)
+            {
+                animation.banks[w] = banks[w];
+            }
+
+            for(int f = 0, frames = animation.frames.count(); f != frames; ++f)
+            {
+                for(int p = 0, parts = animation.frames[f].parts.count(); p != parts; ++p)
+                {
+                    auto& part = animation.frames[f].parts[p];
+                    auto mapping = resolved[source.chrTile(part.tile)];
+                    int index = newIndex[mapping.first];
+                    int window = banks.indexOf(index / bankTiles);
+
+                    part.tile = window * bankTiles + index % bankTiles;
+                    if(mapping.second & ChrTile::HorizontalFlip)
+                    {
+                        part.attributes ^= Part::HorizontalFlip;
+                    }
+                    if(mapping.second & ChrTile::VerticalFlip)
+                    {
+                        part.attributes ^= Part::VerticalFlip;
+                    }
+                }
+            }
+        }
+
+        result.valid = true;
+        return result;
+    }
+
+    BankOptimizer::ChainResult BankOptimizer::runChain(const Chain& chain)
+    {
+        const auto& problem = *chain.problem;
+        int banks = problem.banks;
+        int bankTiles = problem.bankTiles;
+
+        ChainResult result;
+        result.seed = chain.seed;
+        result.bankOf = problem.initial;
+        result.cost = cost(problem, problem.initial, true);
+        if(problem.tiles == 0 || banks < 2)
+        {
+            return result;
+        }
+
+        QVector<int> bankOf(problem.initial);
+        QVector<int> members(banks * bankTiles, -1);
+        QVector<int> slotOf(problem.tiles);
+        QVector<int> fill(banks, 0);
+        QVector<int> usage(problem.animationTiles.count() * banks, 0);
+        QVector<int> distinct(problem.animationTiles.count(), 0);
+        for(int t = 0; t != problem.tiles; ++t)
+        {
+            int b = bankOf[t];
+            slotOf[t] = b * bankTiles + fill[b]++;
+            members[slotOf[t]] = t;
+            foreach(int a, problem.tileAnimations[t])
+            {
+                if(usage[a * banks + b]++ == 0)
+                {
+                    ++distinct[a];
+                }
+            }
+        }
+
+        // Moves tile t into the given slot, returning the change in cost.
+        auto move = [&](int t, int slot) -> int
+        {
+            int from = bankOf[t];
+            int to = slot / bankTiles;
+            int delta = 0;
+            foreach(int a, problem.tileAnimations[t])
+            {
+                int before = distinct[a];
+                if(--usage[a * banks + from] == 0)
+                {
+                    --distinct[a];
+                }
+                if(usage[a * banks + to]++ == 0)
+                {
+                    ++distinct[a];
+                }
+                delta += problem.animationCost(distinct[a]) - problem.animationCost(before);
+            }
+            if(members[slotOf[t]] == t)
+            {
+                members[slotOf[t]] = -1;
+            }
+            members[slot] = t;
+            slotOf[t] = slot;
+            bankOf[t] = to;
+            return delta;
+        };
+
+        Random random(chain.seed);
+        int current = result.cost;
+        double temperature = 2.0;
+        double cooling = std::pow(0.05 / temperature, 1.0 / qMax(chain.iterations, 1));
+        for(int i = 0; i != chain.iterations; ++i, temperature *= cooling)
+        {
+            int t = random.next() % problem.tiles;
+            int slot = random.next() % members.count();
+            if(slot / bankTiles == bankOf[t])
+            {
+                continue;
+            }
+
+            int oldSlot = slotOf[t];
+            int u = members[slot];
+            int delta = move(t, slot);
+            if(u != -1)
+            {
+                delta += move(u, oldSlot);
+            }
+
+            if(delta <= 0 || random.unit() < std::exp(-delta / temperature))
+            {
+                current += delta;
+                if(current < result.cost)
+                {
+                    result.cost = current;
+                    result.bankOf = bankOf;
+                }
+            }
+            else
+            {
+                move(t, oldSlot);
+                if(u != -1)
+                {
+                    move(u, slot);
+                }
+            }
+        }
+        return result;
+    }
+
+    int BankOptimizer::cost(const Problem& problem, const QVector<int>& bankOf, bool penalize)
+    {
+        int total = 0;
+        foreach(const QVector<int>& tiles, problem.animationTiles)
+        {
+            QSet<int> banks;
+            foreach(int t, tiles)
+            {
+                banks.insert(bankOf[t]);
+            }
+            total += penalize ? problem.animationCost(banks.count()) : banks.count();
+        }
+        return total;
+    }
+}
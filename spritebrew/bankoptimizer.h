@@ -0,0 +1,48 @@
+#ifndef BANKOPTIMIZER_H
+#define BANKOPTIMIZER_H
+
+#include <QtGui>
+#include "metasprite.h"
+
+namespace spritebrew
+{
+    // Merges duplicate (and flipped duplicate) tiles used by a cast of animations,
+    // then packs them into fixed-size CHR banks so each animation touches as few banks as possible.
+    // Tiles no part uses are kept, in whatever bank space is left over.
+    class BankOptimizer
+    {
+        public:
+            struct Result
+            {
+                bool valid;
+                QString error;
+                QByteArray chr;
+                QVector<Animation> animations;
+                int usedTiles;
+                int uniqueTiles;
+                int flippedTiles;
+                int keptTiles;
+                int banks;
+                int naiveSwitches;
+                int switches;
+            };
+
+            BankOptimizer(const QByteArray& chr, const QVector<Animation>& animations, int bankTiles);
+
+            Result optimize(int iterations = 200000) const;
+
+        private:
+            struct Problem;
+            struct Chain;
+            struct ChainResult;
+
+            static ChainResult runChain(const Chain& chain);
+            static int cost(const Problem& problem, const QVector<int>& bankOf, bool penalize);
+
+            QByteArray chr;
+            QVector<Animation> animations;
+            int bankTiles;
+    };
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "chrtile.h"
+#include "tilestore.h"
+
+namespace spritebrew
+{
+    using overbrew::TileStore;
+
+    QByteArray ChrTile::flip(const QByteArray& tile, int flips)
+    {
+        QByteArray result(tile.size(), '\0');
+        TileStore::flip(tile.constData(), result.data(), tile.size() / 2, flips);
+        return result;
+    }
+
+    QByteArray ChrTile::canonical(const QByteArray& tile, int* flips)
+    {
+        // The smallest of the four flipped variants represents all of them.
+        QByteArray best(tile);
+        *flips = 0;
+        for(int f = HorizontalFlip; f <= (HorizontalFlip | VerticalFlip); ++f)
+        {
+            QByteArray variant(flip(tile, f));
+            if(variant < best)
+            {
+                best = variant;
+                *flips = f;
+            }
+        }
+        return best;
+    }
+
+    QByteArray ChrTile::tileAt(const QByteArray& chr, int index)
+    {
+        if(index >= 0 && (index + 1) * BYTES <= chr.size())
+        {
+            return chr.mid(index * BYTES, BYTES);
+        }
+        return QByteArray(BYTES, '\0');
+    }
+
+    QByteArray ChrTile::encode(const char* pixels)
+    {
+        // pixels holds 8x8 color indices, row by row.
+        QByteArray tile(BYTES, '\0');
+        for(int j = 0; j != 8; ++j)
+        {
+            unsigned char low = 0;
+            unsigned char high = 0;
+            for(int i = 0; i != 8; ++i)
+            {
+                unsigned int color = pixels[j * 8 + i];
+                low = (low << 1) | (color & 0x1);
+                high = (high << 1) | ((color & 0x2) >> 1);
+            }
+            tile[j * 2] = low;
+            tile[j * 2 + 1] = high;
+        }
+        return tile;
+    }
+}
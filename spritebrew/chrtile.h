@@ -0,0 +1,27 @@
+#ifndef CHRTILE_H
+#define CHRTILE_H
+
+#include <QtGui>
+
+namespace spritebrew
+{
+    // Helpers for raw 16-byte tiles (one low/high byte pair per row).
+    class ChrTile
+    {
+        public:
+            static const int BYTES = 16;
+
+            enum
+            {
+                HorizontalFlip = 0x1,
+                VerticalFlip = 0x2
+            };
+
+            static QByteArray flip(const QByteArray& tile, int flips);
+            static QByteArray canonical(const QByteArray& tile, int* flips);
+            static QByteArray tileAt(const QByteArray& chr, int index);
+            static QByteArray encode(const char* pixels);
+    };
+}
+
+#endif
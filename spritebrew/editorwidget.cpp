@@ -1,11 +1,35 @@
 #include <QMessageBox>
 
 #include "editorwidget.h"
+#include "animationencoder.h"
+#include "atomicfile.h"
+#include "bankoptimizer.h"
+#include "chrtile.h"
+#include "palette.h"
+#include "slicer.h"
+#include "spritetablemodel.h"
+#include "spritetableview.h"
 
 namespace spritebrew
 {
+    using overbrew::AtomicFile;
+
     EditorWidget::EditorWidget()
+        : scanlines(TILE_HEIGHT)
     {
+        Animation animation;
+        animation.name = tr("Animation 0");
+        animation.frames.append(Metasprite());
+        animation.frames[0].parts.append(Part());
+        animations.append(animation);
+        currentAnimation = 0;
+        currentFrame = 0;
+        tall = false;
+        chrColumns = 0;
+        chrRows = 0;
+        sharedSequence = 0;
+        partModel = new SpriteTableModel(&animations, this);
+
         auto mainLayout = new QVBoxLayout();
         mainLayout->setAlignment(Qt::AlignTop);
         setLayout(mainLayout);
@@ -32,6 +56,48 @@ namespace spritebrew
 
             imageLabel = new QLabel();
             groupLayout->addWidget(imageLabel);
+
+            auto bankLayout = new QHBoxLayout();
+            bankLayout->setAlignment(Qt::AlignLeft);
+            groupLayout->addLayout(bankLayout);
+
+            bankLayout->addWidget(new QLabel(tr("Sprite Size")));
+            spriteSizeBox = new QComboBox();
+            spriteSizeBox->addItem(tr("8x8"), TILE_HEIGHT);
+            spriteSizeBox->addItem(tr("8x16"), TILE_HEIGHT * 2);
+            bankLayout->addWidget(spriteSizeBox);
+
+            bankLayout->addWidget(new QLabel(tr("Bank Size")));
+            bankSizeBox = new QComboBox();
+            bankSizeBox->addItem(tr("1 KB"), 64);
+            bankSizeBox->addItem(tr("2 KB"), 128);
+            bankLayout->addWidget(bankSizeBox);
+
+            optimizeBanksButton = new QPushButton(tr("&Optimize Banks"));
+            optimizeBanksButton->setEnabled(false);
+            bankLayout->addWidget(optimizeBanksButton);
+
+            saveCHRButton = new QPushButton(tr("Save CHR..."));
+            saveCHRButton->setEnabled(false);
+            bankLayout->addWidget(saveCHRButton);
+
+            followOption = new QCheckBox(tr("Follow chrbrew"));
+            bankLayout->addWidget(followOption);
+
+            followTimer = new QTimer(this);
+            followTimer->setInterval(100);
+        }
+        if(auto group = new QGroupBox(tr("Palette Variants")))
+        {
+            mainLayout->addWidget(group);
+
+            auto groupLayout = new QVBoxLayout();
+            groupLayout->setAlignment(Qt::AlignCenter | Qt::AlignTop);
+            group->setLayout(groupLayout);
+
+            variantsLabel = new QLabel(tr("Import a character set and palettes to compare them here."));
+            variantsLabel->setAlignment(Qt::AlignCenter);
+            groupLayout->addWidget(variantsLabel);
         }
         if(auto rowLayout = new QHBoxLayout())
         {
@@ -47,21 +113,64 @@ namespace spritebrew
                     groupLayout->setAlignment(Qt::AlignTop);
                     group->setLayout(groupLayout);
 
-                    for(int i = 0; i != 8; ++i)
+                    paletteMapper = new QSignalMapper(this);
+                    for(int i = 0; i != PaletteStore::SLOTS; ++i)
                     {
                         auto label = new QLabel(tr("Palette %1 is unused.").arg(i));
                         groupLayout->addWidget(label, i, 0);
+                        paletteLabels.append(label);
+
+                        auto swatchLayout = new QHBoxLayout();
+                        swatchLayout->setSpacing(2);
+                        groupLayout->addLayout(swatchLayout, i, 1);
+                        for(int c = 0; c != PaletteStore::COLORS; ++c)
+                        {
+                            auto swatch = new QLabel();
+                            swatch->setMinimumWidth(16);
+                            swatch->setMinimumHeight(16);
+                            swatch->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+                            swatch->setAutoFillBackground(true);
+                            swatch->hide();
+                            swatchLayout->addWidget(swatch);
+                            paletteSwatches.append(swatch);
+                        }
 
                         auto button = new QPushButton(tr("&Import..."));
                         button->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
                         button->setAutoDefault(true);
-                        groupLayout->addWidget(button, i, 1);
+                        groupLayout->addWidget(button, i, 2);
+
+                        connect(button, SIGNAL(clicked()), paletteMapper, SLOT(map()));
+                        paletteMapper->setMapping(button, i);
                     }
+                    connect(paletteMapper, SIGNAL(mapped(int)), this, SLOT(importPalette(int)));
                 }
             }
             if(QVBoxLayout* columnLayout = new QVBoxLayout())
             {
                 rowLayout->addLayout(columnLayout);
+                if(auto group = new QGroupBox(tr("Animation")))
+                {
+                    columnLayout->addWidget(group);
+
+                    auto groupLayout = new QGridLayout();
+                    group->setLayout(groupLayout);
+
+                    animationBox = new QComboBox();
+                    groupLayout->addWidget(animationBox, 0, 0, 1, 3);
+
+                    groupLayout->addWidget(new QLabel(tr("Frame")), 1, 0);
+                    frameSpinBox = new QSpinBox();
+                    groupLayout->addWidget(frameSpinBox, 1, 1);
+                    frameCountLabel = new QLabel();
+                    groupLayout->addWidget(frameCountLabel, 1, 2);
+
+                    sliceImageButton = new QPushButton(tr("Slice &Image..."));
+                    groupLayout->addWidget(sliceImageButton, 2, 0, 1, 3);
+
+                    exportAnimationsButton = new QPushButton(tr("E&xport Animations..."));
+                    groupLayout->addWidget(exportAnimationsButton, 3, 0, 1, 3);
+                }
                 if(auto group = new QGroupBox(tr("Parts")))
                 {
                     columnLayout->addWidget(group);
@@ -70,13 +179,17 @@ namespace spritebrew
                     group->setLayout(groupLayout);
 
                     groupLayout->addWidget(new QLabel(tr("Total Used")), 0, 0);
-                    groupLayout->addWidget(new QLabel("1"), 0, 1, 1, 2);
+                    partCountLabel = new QLabel("1");
+                    groupLayout->addWidget(partCountLabel, 0, 1, 1, 2);
 
                     groupLayout->addWidget(new QLabel(tr("Current Part")), 1, 0);
-                    groupLayout->addWidget(new QSpinBox(), 1, 1, 1, 2);
+                    currentPartSpinBox = new QSpinBox();
+                    groupLayout->addWidget(currentPartSpinBox, 1, 1, 1, 2);
 
-                    groupLayout->addWidget(new QPushButton(tr("Add")), 2, 0);
-                    groupLayout->addWidget(new QPushButton(tr("Remove")), 2, 1);
+                    addPartButton = new QPushButton(tr("Add"));
+                    groupLayout->addWidget(addPartButton, 2, 0);
+                    removePartButton = new QPushButton(tr("Remove"));
+                    groupLayout->addWidget(removePartButton, 2, 1);
                     groupLayout->addWidget(new QPushButton(tr("Move...")), 2, 2);
                 }
                 if(auto group = new QGroupBox(tr("Part Properties")))
@@ -86,14 +199,23 @@ namespace spritebrew
                     auto groupLayout = new QGridLayout();
                     group->setLayout(groupLayout);
 
+                    partXSpinBox = new QSpinBox();
+                    partXSpinBox->setRange(-128, 127);
+                    partYSpinBox = new QSpinBox();
+                    partYSpinBox->setRange(-128, 127);
+                    partTileSpinBox = new QSpinBox();
+                    partTileSpinBox->setRange(0, 255);
+                    partPaletteSpinBox = new QSpinBox();
+                    partPaletteSpinBox->setRange(0, Part::PaletteMask);
+
                     groupLayout->addWidget(new QLabel(tr("X")), 0, 0);
-                    groupLayout->addWidget(new QSpinBox(), 0, 1);
+                    groupLayout->addWidget(partXSpinBox, 0, 1);
                     groupLayout->addWidget(new QLabel(tr("Tile")), 0, 2);
-                    groupLayout->addWidget(new QSpinBox(), 0, 3);
+                    groupLayout->addWidget(partTileSpinBox, 0, 3);
                     groupLayout->addWidget(new QLabel(tr("Y")), 1, 0);
-                    groupLayout->addWidget(new QSpinBox(), 1, 1);
+                    groupLayout->addWidget(partYSpinBox, 1, 1);
                     groupLayout->addWidget(new QLabel(tr("Palette")), 1, 2);
-                    groupLayout->addWidget(new QSpinBox(), 1, 3);
+                    groupLayout->addWidget(partPaletteSpinBox, 1, 3);
                 }
                 if(auto group = new QGroupBox(tr("Part Attributes")))
                 {
@@ -102,12 +224,66 @@ namespace spritebrew
                     auto groupLayout = new QVBoxLayout();
                     group->setLayout(groupLayout);
 
-                    groupLayout->addWidget(new QCheckBox(tr("Horizontal Flip")));
-                    groupLayout->addWidget(new QCheckBox(tr("Vertical Flip")));
-                    groupLayout->addWidget(new QCheckBox(tr("Behind Background")));
+                    horizontalFlipOption = new QCheckBox(tr("Horizontal Flip"));
+                    groupLayout->addWidget(horizontalFlipOption);
+                    verticalFlipOption = new QCheckBox(tr("Vertical Flip"));
+                    groupLayout->addWidget(verticalFlipOption);
+                    behindBackgroundOption = new QCheckBox(tr("Behind Background"));
+                    groupLayout->addWidget(behindBackgroundOption);
                 }
             }
         }
+        if(auto group = new QGroupBox(tr("Part List")))
+        {
+            mainLayout->addWidget(group);
+
+            auto groupLayout = new QVBoxLayout();
+            group->setLayout(groupLayout);
+
+            partTable = new SpriteTableView();
+            partTable->setModel(partModel);
+            groupLayout->addWidget(partTable);
+        }
+        if(auto group = new QGroupBox(tr("Scanlines")))
+        {
+            mainLayout->addWidget(group);
+
+            auto groupLayout = new QGridLayout();
+            group->setLayout(groupLayout);
+
+            groupLayout->addWidget(new QLabel(tr("Frame Y")), 0, 0);
+            originYSpinBox = new QSpinBox();
+            originYSpinBox->setRange(0, ScanlineAnalyzer::LineCount - 1);
+            originYSpinBox->setValue(ORIGIN_Y);
+            groupLayout->addWidget(originYSpinBox, 0, 1);
+
+            auto buttonLayout = new QHBoxLayout();
+            groupLayout->addLayout(buttonLayout, 1, 0, 1, 2);
+            addToSceneButton = new QPushButton(tr("Add Frame to Scene"));
+            buttonLayout->addWidget(addToSceneButton);
+            clearSceneButton = new QPushButton(tr("Clear Scene"));
+            buttonLayout->addWidget(clearSceneButton);
+
+            sceneLabel = new QLabel();
+            sceneLabel->setWordWrap(true);
+            groupLayout->addWidget(sceneLabel, 2, 0, 1, 2);
+
+            overflowLabel = new QLabel();
+            overflowLabel->setWordWrap(true);
+            groupLayout->addWidget(overflowLabel, 3, 0, 1, 2);
+
+            groupLayout->addWidget(new QLabel(tr("OAM Cycling")), 4, 0);
+            flickerStrategyBox = new QComboBox();
+            flickerStrategyBox->addItem(tr("None (fixed order)"), ScanlineAnalyzer::FixedOrder);
+            flickerStrategyBox->addItem(tr("Rotate start each frame"), ScanlineAnalyzer::RotateOrder);
+            flickerStrategyBox->addItem(tr("Reverse every other frame"), ScanlineAnalyzer::ReverseOrder);
+            flickerStrategyBox->addItem(tr("Prime stride"), ScanlineAnalyzer::StrideOrder);
+            groupLayout->addWidget(flickerStrategyBox, 4, 1);
+
+            flickerLabel = new QLabel();
+            flickerLabel->setWordWrap(true);
+            groupLayout->addWidget(flickerLabel, 5, 0, 1, 2);
+        }
         if(auto group = new QGroupBox(tr("Preview")))
         {
             mainLayout->addWidget(group);
@@ -115,8 +291,44 @@ namespace spritebrew
             auto groupLayout = new QVBoxLayout();
             groupLayout->setAlignment(Qt::AlignCenter | Qt::AlignTop);
             group->setLayout(groupLayout);
+
+            previewLabel = new QLabel();
+            previewLabel->setAlignment(Qt::AlignCenter);
+            groupLayout->addWidget(previewLabel);
         }
         connect(imageBrowseButton, SIGNAL(clicked()), this, SLOT(browse()));
+        connect(spriteSizeBox, SIGNAL(currentIndexChanged(int)), this, SLOT(spriteSizeChanged(int)));
+        connect(optimizeBanksButton, SIGNAL(clicked()), this, SLOT(optimizeBanks()));
+        connect(saveCHRButton, SIGNAL(clicked()), this, SLOT(saveCHR()));
+        connect(followOption, SIGNAL(toggled(bool)), this, SLOT(followChanged(bool)));
+        connect(followTimer, SIGNAL(timeout()), this, SLOT(pollShared()));
+        connect(animationBox, SIGNAL(currentIndexChanged(int)), this, SLOT(animationChanged(int)));
+        connect(frameSpinBox, SIGNAL(valueChanged(int)), this, SLOT(frameChanged(int)));
+        connect(sliceImageButton, SIGNAL(clicked()), this, SLOT(sliceImage()));
+        connect(exportAnimationsButton, SIGNAL(clicked()), this, SLOT(exportAnimations()));
+        connect(addPartButton, SIGNAL(clicked()), this, SLOT(addPart()));
+        connect(removePartButton, SIGNAL(clicked()), this, SLOT(removePart()));
+        connect(currentPartSpinBox, SIGNAL(valueChanged(int)), this, SLOT(currentPartChanged(int)));
+        connect(partXSpinBox, SIGNAL(valueChanged(int)), this, SLOT(partChanged()));
+        connect(partYSpinBox, SIGNAL(valueChanged(int)), this, SLOT(partChanged()));
+        connect(partTileSpinBox, SIGNAL(valueChanged(int)), this, SLOT(partChanged()));
+        connect(partPaletteSpinBox, SIGNAL(valueChanged(int)), this, SLOT(partChanged()));
+        connect(horizontalFlipOption, SIGNAL(toggled(bool)), this, SLOT(partChanged()));
+        connect(verticalFlipOption, SIGNAL(toggled(bool)), this, SLOT(partChanged()));
+        connect(behindBackgroundOption, SIGNAL(toggled(bool)), this, SLOT(partChanged()));
+        connect(partTable->selectionModel(), SIGNAL(currentRowChanged(const QModelIndex&, const QModelIndex&)), this, SLOT(tableRowChanged(const QModelIndex&)));
+        connect(partModel, SIGNAL(partEdited(int, int)), this, SLOT(tablePartEdited(int, int)));
+        connect(flickerStrategyBox, SIGNAL(currentIndexChanged(int)), this, SLOT(flickerStrategyChanged(int)));
+        connect(originYSpinBox, SIGNAL(valueChanged(int)), this, SLOT(originYChanged(int)));
+        connect(addToSceneButton, SIGNAL(clicked()), this, SLOT(addToScene()));
+        connect(clearSceneButton, SIGNAL(clicked()), this, SLOT(clearScene()));
+
+        updating = false;
+        updateAnimationFields();
+        updatePartFields();
+        updateSceneFields();
+        rebuildScanlines();
+        updatePreview();
     }
 
     void EditorWidget::browse()
@@ -163,69 +375,324 @@ namespace spritebrew
             return false;
         }
 
-        // Try to fit this in a nice rectangular region, so it's easier to view.
-        int columns = 0;
-        int rows = 0;
-        for(int i = 16; i != 1; i /= 2)
+        chr = TileStore(file.read(tiles * ChrTile::BYTES));
+
+        return true;
+    }
+
+    void EditorWidget::renderCHR(bool store)
+    {
+        int cellTiles = spriteHeight() / TILE_HEIGHT;
+        TileStore::sheetLayout(chr.count(), cellTiles, &chrColumns, &chrRows);
+
+        // Tall cells hold a tile pair: even tile on top, odd tile below.
+        // The sheet is the same one chrbrew decodes, so it's left in the cache for chrbrew to reuse;
+        // this tool draws its views straight from the packed tiles and keeps no decoded copy.
+        auto key = AssetCache::sheetKey(chr.bytes(), cellTiles);
+        AssetCache::Entry cached;
+        if(store && !cache.load(key, &cached))
         {
-            if(tiles % i == 0)
+            cached.image = chr.renderIndexed(chrColumns, chrRows, cellTiles);
+            for(int i = 0; i != PaletteStore::COLORS; ++i)
             {
-                if(i >= 8)
-                {
-                    columns = i;
-                    rows = tiles / i;
-                }
-                else
-                {
-                    rows = i;
-                    columns = tiles / i;
-                }
-                break;
+                cached.image.setColor(i, getPaletteColor(i));
             }
+            cache.store(key, cached);
         }
-        if(columns == 0)
+        updateCHRViews();
+    }
+
+    QImage EditorWidget::chrView(const QVector<QRgb>& colors) const
+    {
+        return chr.render(chrColumns, chrRows, spriteHeight() / TILE_HEIGHT, colors.constData());
+    }
+
+    void EditorWidget::updateCHRViews()
+    {
+        if(chrColumns == 0)
         {
-            columns = tiles;
-            rows = 1;
+            return;
         }
 
-        image = QImage(columns * 8, rows * 8, QImage::Format_Indexed8);
-        image.setColorCount(4);
-        for(int i = 0; i != 4; ++i)
+        QVector<QRgb> grays(PaletteStore::COLORS);
+        for(int i = 0; i != PaletteStore::COLORS; ++i)
         {
-            image.setColor(i, getPaletteColor(i));
+            grays[i] = getPaletteColor(i);
         }
-        image.fill(0);
+        imageLabel->setPixmap(QPixmap::fromImage(chrView(grays)));
 
-        QByteArray bytes(file.read(file.size()));
-        for(int r = 0; r != rows; ++r)
+        QList<int> used;
+        for(int slot = 0; slot != PaletteStore::SLOTS; ++slot)
         {
-            for(int c = 0; c != columns; ++c)
+            if(palettes.isUsed(slot))
             {
-                for(int j = 0; j != 8; ++j)
-                {
-                    int index = ((r * columns + c) * 8 + j) * 2;
-                    unsigned char low = bytes[index];
-                    unsigned char high = bytes[index + 1];
-                    for(int i = 0; i != 8; ++i)
-                    {
-                        image.setPixel(
-                            c * 8 + i,
-                            r * 8 + j,
-                            ((high & (1 << (7 - i))) ? 2 : 0) | ((low & (1 << (7 - i))) ? 1 : 0)
-                        );
-                    }
-                }
+                used.append(slot);
             }
         }
+        if(used.isEmpty())
+        {
+            variantsLabel->setText(tr("Import palettes to compare them here."));
+            return;
+        }
 
-        return true;
+        // Every variant is painted into one strip in a single pass.
+        const int gap = TILE_WIDTH;
+        int w = chrColumns * TILE_WIDTH;
+        QImage strip(used.count() * (w + gap) - gap, chrRows * spriteHeight(), QImage::Format_RGB32);
+        strip.fill(palette().color(QPalette::Window).rgb());
+        QPainter painter(&strip);
+        for(int i = 0, end = used.count(); i != end; ++i)
+        {
+            QVector<QRgb> colors(PaletteStore::COLORS);
+            for(int c = 0; c != PaletteStore::COLORS; ++c)
+            {
+                colors[c] = palettes.color(used[i], c);
+            }
+            painter.drawImage(i * (w + gap), 0, chrView(colors));
+        }
+        painter.end();
+        variantsLabel->setPixmap(QPixmap::fromImage(strip));
+    }
+
+    void EditorWidget::followChanged(bool checked)
+    {
+        if(checked)
+        {
+            // Start over, so the first poll brings in every tile.
+            sharedSequence = 0;
+            followTimer->start();
+            pollShared();
+        }
+        else
+        {
+            followTimer->stop();
+        }
+    }
+
+    void EditorWidget::pollShared()
+    {
+        auto bytes = chr.bytes();
+        QList<int> changed;
+        if(!sharedCHR.poll(&sharedSequence, &bytes, &changed))
+        {
+            return;
+        }
+
+        bool relayout = bytes.size() != chr.bytes().size() || chrColumns == 0;
+        chr = TileStore(bytes);
+        if(relayout)
+        {
+            imageFilenameLabel->setText(tr("<b>Following chrbrew</b>"));
+            renderCHR();
+            optimizeBanksButton->setEnabled(!tall);
+            saveCHRButton->setEnabled(true);
+        }
+        else
+        {
+            updateCHRViews();
+        }
+        updatePreview();
     }
 
     void EditorWidget::setupImage(const QString& filename)
     {
         imageFilenameLabel->setText(tr("<b>%1</b>").arg(QFileInfo(filename).fileName()));
-        imageLabel->setPixmap(QPixmap::fromImage(image));
+        renderCHR(true);
+        optimizeBanksButton->setEnabled(!tall);
+        saveCHRButton->setEnabled(true);
+        updatePreview();
+    }
+
+    void EditorWidget::importPalette(int slot)
+    {
+        auto filename = QFileDialog::getOpenFileName(
+            this,
+            tr("Import Palette %1").arg(slot),
+            QString(),
+            tr(
+                "15-bit RGB Palettes (*.pal *.bin)"
+                ";;All Files (*.*)"
+            )
+        );
+        if(!filename.isEmpty())
+        {
+            readPalette(slot, filename);
+        }
+    }
+
+    bool EditorWidget::readPalette(int slot, const QString& filename)
+    {
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' could not be imported as a palette.").arg(filename));
+            return false;
+        }
+
+        // Little-endian 15-bit colors, xBBBBBGGGGGRRRRR. Only the first four are used.
+        QByteArray bytes(file.read(PaletteStore::COLORS * 2));
+        int count = bytes.size() / 2;
+        if(count == 0)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' has no colors! (File size is %2 byte(s))").arg(filename).arg(file.size()));
+            return false;
+        }
+
+        QVector<quint16> colors(count);
+        for(int i = 0; i != count; ++i)
+        {
+            colors[i] = (uchar(bytes[i * 2]) | (uchar(bytes[i * 2 + 1]) << 8)) & 0x7FFF;
+        }
+        palettes.setColors(slot, colors);
+
+        paletteLabels[slot]->setText(tr("Palette %1: <b>%2</b>").arg(slot).arg(QFileInfo(filename).fileName()));
+        for(int c = 0; c != PaletteStore::COLORS; ++c)
+        {
+            auto swatch = paletteSwatches[slot * PaletteStore::COLORS + c];
+            swatch->setPalette(QPalette(QColor(palettes.color(slot, c))));
+            swatch->show();
+        }
+
+        updateCHRViews();
+        updatePreview();
+        return true;
+    }
+
+    void EditorWidget::spriteSizeChanged(int index)
+    {
+        tall = spriteSizeBox->itemData(index).toInt() != TILE_HEIGHT;
+        scanlines.setSpriteHeight(spriteHeight());
+        partTileSpinBox->setPrefix(tall ? tr("Pair ") : QString());
+
+        if(!chr.isEmpty())
+        {
+            renderCHR();
+            optimizeBanksButton->setEnabled(!tall);
+        }
+        updatePartFields();
+        rebuildScanlines();
+        updatePreview();
+    }
+
+    void EditorWidget::optimizeBanks()
+    {
+        int bankTiles = bankSizeBox->itemData(bankSizeBox->currentIndex()).toInt();
+
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        auto result = BankOptimizer(chr.bytes(), animations, bankTiles).optimize();
+        QApplication::restoreOverrideCursor();
+
+        if(!result.valid)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Optimize Failed"), result.error);
+            return;
+        }
+
+        chr = TileStore(result.chr);
+        animations = result.animations;
+        partModel->reset();
+        renderCHR();
+        updatePartFields();
+        rebuildScanlines();
+        updatePreview();
+
+        QMessageBox::information(this->parentWidget(), tr("Banks Optimized"), tr(
+                "%1 tile(s) in use, %2 after merging duplicates (%3 flipped).<br>"
+                "%4 unused tile(s) kept. Packed into %5 bank(s). Bank loads across all animations: %6 (was %7)."
+            )
+            .arg(result.usedTiles)
+            .arg(result.uniqueTiles)
+            .arg(result.flippedTiles)
+            .arg(result.keptTiles)
+            .arg(result.banks)
+            .arg(result.switches)
+            .arg(result.naiveSwitches)
+        );
+    }
+
+    void EditorWidget::saveCHR()
+    {
+        auto filename = QFileDialog::getSaveFileName(
+            this,
+            tr("Save Character Set"),
+            QString(),
+            tr("Character Sets (*.chr);;")
+        );
+        if(!filename.isEmpty())
+        {
+            writeCHR(filename);
+        }
+    }
+
+    bool EditorWidget::writeCHR(const QString& filename)
+    {
+        AtomicFile file(filename);
+        if(!file.open())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), file.errorString());
+            return false;
+        }
+        file.write(chr.bytes());
+        if(!file.commit())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), file.errorString());
+            return false;
+        }
+        return true;
+    }
+
+    void EditorWidget::exportAnimations()
+    {
+        auto filename = QFileDialog::getSaveFileName(
+            this,
+            tr("Export Animations"),
+            QString(),
+            tr("Metasprite Tables (*.bin);;")
+        );
+        if(!filename.isEmpty())
+        {
+            writeAnimations(filename);
+        }
+    }
+
+    bool EditorWidget::writeAnimations(const QString& filename)
+    {
+        auto result = AnimationEncoder(animations).encode();
+        if(!result.valid)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), result.error);
+            return false;
+        }
+
+        AtomicFile file(filename);
+        if(!file.open())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), file.errorString());
+            return false;
+        }
+        file.write(result.data);
+        if(!file.commit())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Export Failed"), file.errorString());
+            return false;
+        }
+
+        QString report;
+        foreach(const AnimationEncoder::Stats& stats, result.animations)
+        {
+            report += tr("%1: %2 byte(s) as %3 (raw %4).<br>")
+                .arg(Qt::escape(stats.name))
+                .arg(stats.bytes)
+                .arg(AnimationEncoder::name(stats.encoding))
+                .arg(stats.rawBytes);
+        }
+        QMessageBox::information(this->parentWidget(), tr("Animations Exported"), report + tr("<br>%1 byte(s) in total, saving %2 of %3 (%4%).")
+            .arg(result.bytes)
+            .arg(result.rawBytes - result.bytes)
+            .arg(result.rawBytes)
+            .arg(result.rawBytes ? (result.rawBytes - result.bytes) * 100 / result.rawBytes : 0)
+        );
+        return true;
     }
 
     QRgb EditorWidget::getPaletteColor(int i)
@@ -239,4 +706,543 @@ namespace spritebrew
             default: return qRgb(0xFF, 0x00, 0xFF); break;
         }
     }
+
+    int EditorWidget::spriteHeight() const
+    {
+        return tall ? TILE_HEIGHT * 2 : TILE_HEIGHT;
+    }
+
+    Metasprite& EditorWidget::currentSprite()
+    {
+        return animations[currentAnimation].frames[currentFrame];
+    }
+
+    int EditorWidget::originY() const
+    {
+        return originYSpinBox->value();
+    }
+
+    void EditorWidget::animationChanged(int index)
+    {
+        if(!updating && index != -1)
+        {
+            setCurrentFrame(index, 0);
+        }
+    }
+
+    void EditorWidget::frameChanged(int index)
+    {
+        if(!updating)
+        {
+            setCurrentFrame(currentAnimation, index);
+        }
+    }
+
+    void EditorWidget::sliceImage()
+    {
+        auto filename = QFileDialog::getOpenFileName(
+            this,
+            tr("Slice Sprite Image"),
+            QString(),
+            tr(
+                "Images (*.png *.gif *.bmp)"
+                ";;All Files (*.*)"
+            )
+        );
+        if(filename.isEmpty())
+        {
+            return;
+        }
+
+        QImage source(filename);
+        if(source.isNull())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' could not be imported as an image.").arg(filename));
+            return;
+        }
+
+        bool ok;
+        int frameWidth = QInputDialog::getInt(this, tr("Slice Sprite Image"), tr("Frame width:"),
+            source.width() % source.height() == 0 ? source.height() : source.width(), 1, qMin(source.width(), 256), 1, &ok);
+        if(!ok)
+        {
+            return;
+        }
+        int frameHeight = QInputDialog::getInt(this, tr("Slice Sprite Image"), tr("Frame height:"),
+            qMin(source.height(), 256), 1, qMin(source.height(), 256), 1, &ok);
+        if(!ok)
+        {
+            return;
+        }
+
+        // Remap to a loaded palette if there is one, otherwise pick shades over the whole sheet.
+        QStringList choices(tr("Automatic (by brightness)"));
+        QList<int> paletteSlots;
+        for(int i = 0; i != PaletteStore::SLOTS; ++i)
+        {
+            if(palettes.isUsed(i))
+            {
+                choices.append(tr("Palette %1").arg(i));
+                paletteSlots.append(i);
+            }
+        }
+        int paletteSlot = -1;
+        if(!paletteSlots.isEmpty())
+        {
+            auto choice = QInputDialog::getItem(this, tr("Slice Sprite Image"), tr("Palette:"), choices, 1, false, &ok);
+            if(!ok)
+            {
+                return;
+            }
+            int index = choices.indexOf(choice);
+            paletteSlot = index > 0 ? paletteSlots[index - 1] : -1;
+        }
+
+        QImage indexed = paletteSlot == -1 ? Slicer::indexed(source) : Slicer::indexed(source, palettes.lookup(paletteSlot));
+        QList<QImage> frames;
+        for(int y = 0; y + frameHeight <= indexed.height(); y += frameHeight)
+        {
+            for(int x = 0; x + frameWidth <= indexed.width(); x += frameWidth)
+            {
+                frames.append(indexed.copy(x, y, frameWidth, frameHeight));
+            }
+        }
+
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        auto results = Slicer(spriteHeight()).sliceAll(frames);
+        QApplication::restoreOverrideCursor();
+
+        // Reuse tiles (or tile pairs) already in the character set, flipped or not.
+        int unitBytes = ChrTile::BYTES * spriteHeight() / TILE_HEIGHT;
+        QByteArray newCHR(chr.bytes());
+        if(newCHR.size() % unitBytes)
+        {
+            newCHR.append(QByteArray(unitBytes - newCHR.size() % unitBytes, '\0'));
+        }
+        QHash<QByteArray, QPair<int, int> > known;
+        for(int i = 0, end = newCHR.size() / unitBytes; i != end; ++i)
+        {
+            int flips;
+            auto key = ChrTile::canonical(newCHR.mid(i * unitBytes, unitBytes), &flips);
+            if(!known.contains(key))
+            {
+                known.insert(key, qMakePair(i, flips));
+            }
+        }
+
+        Animation animation;
+        animation.name = QFileInfo(filename).completeBaseName();
+        int reused = 0;
+        foreach(const Slicer::Result& result, results)
+        {
+            Metasprite frame;
+            foreach(const Slicer::Slice& slice, result.slices)
+            {
+                int flips;
+                QByteArray tile;
+                for(int j = 0; j < slice.pixels.size(); j += TILE_WIDTH * TILE_HEIGHT)
+                {
+                    tile.append(ChrTile::encode(slice.pixels.constData() + j));
+                }
+                auto key = ChrTile::canonical(tile, &flips);
+                auto it = known.find(key);
+                if(it == known.end())
+                {
+                    it = known.insert(key, qMakePair(newCHR.size() / unitBytes, flips));
+                    newCHR.append(tile);
+                }
+                else
+                {
+                    ++reused;
+                }
+
+                Part part;
+                part.x = slice.x - frameWidth / 2;
+                part.y = slice.y - frameHeight / 2;
+                part.tile = tall ? Part::tallTile(it.value().first) : it.value().first;
+                flips ^= it.value().second;
+                part.attributes = qMax(paletteSlot, 0)
+                    | (flips & ChrTile::HorizontalFlip ? Part::HorizontalFlip : 0)
+                    | (flips & ChrTile::VerticalFlip ? Part::VerticalFlip : 0);
+                frame.parts.append(part);
+            }
+            animation.frames.append(frame);
+        }
+
+        int tiles = newCHR.size() / ChrTile::BYTES;
+        int maxTiles = tall ? 512 : 256;
+        if(tiles > maxTiles)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("Slicing '%1' needs %2 tiles, but only %3 fit in the character set.").arg(filename).arg(tiles).arg(maxTiles));
+            return;
+        }
+        if(animation.frames.isEmpty())
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' is smaller than one frame.").arg(filename));
+            return;
+        }
+
+        chr = TileStore(newCHR);
+        renderCHR();
+        optimizeBanksButton->setEnabled(!tall);
+        saveCHRButton->setEnabled(true);
+
+        animations.append(animation);
+        updateAnimationFields();
+        setCurrentFrame(animations.count() - 1, 0);
+
+        int parts = 0;
+        int peak = 0;
+        foreach(const Slicer::Result& result, results)
+        {
+            parts += result.slices.count();
+            peak = qMax(peak, result.peak);
+        }
+        QMessageBox::information(this->parentWidget(), tr("Image Sliced"), tr(
+                "%1 frame(s) sliced into %2 part(s), at most %3 on a scanline.<br>"
+                "%4 tile(s) reused, character set now has %5 tile(s)."
+            )
+            .arg(results.count())
+            .arg(parts)
+            .arg(peak)
+            .arg(reused)
+            .arg(tiles)
+        );
+    }
+
+    void EditorWidget::addPart()
+    {
+        auto& sprite = currentSprite();
+        Part part;
+        if(!sprite.parts.isEmpty())
+        {
+            part = sprite.parts[currentPartSpinBox->value()];
+        }
+        partModel->insertPart(sprite.parts.count(), part);
+        scanlines.addSprite(originY() + part.y);
+
+        updatePartFields();
+        currentPartSpinBox->setValue(sprite.parts.count() - 1);
+        partsMoved();
+        updatePreview();
+    }
+
+    void EditorWidget::removePart()
+    {
+        auto& sprite = currentSprite();
+        if(!sprite.parts.isEmpty())
+        {
+            int index = currentPartSpinBox->value();
+            scanlines.removeSprite(originY() + sprite.parts[index].y);
+            partModel->removePart(index);
+
+            updatePartFields();
+            partsMoved();
+            updatePreview();
+        }
+    }
+
+    void EditorWidget::currentPartChanged(int index)
+    {
+        if(!updating)
+        {
+            updatePartFields();
+            partTable->selectRow(index);
+        }
+    }
+
+    void EditorWidget::partChanged()
+    {
+        auto& sprite = currentSprite();
+        if(updating || sprite.parts.isEmpty())
+        {
+            return;
+        }
+
+        int row = currentPartSpinBox->value();
+        Part part;
+        part.x = partXSpinBox->value();
+        part.y = partYSpinBox->value();
+        part.tile = tall ? Part::tallTile(partTileSpinBox->value()) : partTileSpinBox->value();
+        part.attributes = partPaletteSpinBox->value()
+            | (horizontalFlipOption->isChecked() ? Part::HorizontalFlip : 0)
+            | (verticalFlipOption->isChecked() ? Part::VerticalFlip : 0)
+            | (behindBackgroundOption->isChecked() ? Part::BehindBackground : 0);
+
+        int oldY = sprite.parts[row].y;
+        partModel->setPart(row, part);
+        if(part.y != oldY)
+        {
+            scanlines.moveSprite(originY() + oldY, originY() + part.y);
+            partsMoved();
+        }
+        updatePreview();
+    }
+
+    void EditorWidget::tableRowChanged(const QModelIndex& index)
+    {
+        if(index.isValid())
+        {
+            currentPartSpinBox->setValue(index.row());
+        }
+    }
+
+    void EditorWidget::tablePartEdited(int row, int oldY)
+    {
+        int y = currentSprite().parts[row].y;
+        if(y != oldY)
+        {
+            scanlines.moveSprite(originY() + oldY, originY() + y);
+            partsMoved();
+        }
+        if(row == currentPartSpinBox->value())
+        {
+            updatePartFields();
+        }
+        updatePreview();
+    }
+
+    void EditorWidget::flickerStrategyChanged(int index)
+    {
+        updateScanlines();
+    }
+
+    void EditorWidget::originYChanged(int y)
+    {
+        rebuildScanlines();
+    }
+
+    void EditorWidget::addToScene()
+    {
+        Placement placement;
+        placement.animation = currentAnimation;
+        placement.frame = currentFrame;
+        placement.y = originY();
+        scene.append(placement);
+
+        updateSceneFields();
+        rebuildScanlines();
+    }
+
+    void EditorWidget::clearScene()
+    {
+        scene.clear();
+        updateSceneFields();
+        rebuildScanlines();
+    }
+
+    void EditorWidget::setCurrentFrame(int animation, int frame)
+    {
+        currentAnimation = animation;
+        currentFrame = frame;
+        partModel->setFrame(animation, frame);
+
+        updateAnimationFields();
+        currentPartSpinBox->setValue(0);
+        updatePartFields();
+        rebuildScanlines();
+        updatePreview();
+    }
+
+    void EditorWidget::updateAnimationFields()
+    {
+        updating = true;
+        if(animationBox->count() != animations.count())
+        {
+            animationBox->clear();
+            foreach(const Animation& animation, animations)
+            {
+                animationBox->addItem(animation.name);
+            }
+        }
+        animationBox->setCurrentIndex(currentAnimation);
+
+        int frames = animations[currentAnimation].frames.count();
+        frameSpinBox->setRange(0, frames - 1);
+        frameSpinBox->setValue(currentFrame);
+        frameCountLabel->setText(tr("of %1").arg(frames));
+        updating = false;
+    }
+
+    void EditorWidget::updatePartFields()
+    {
+        const auto& sprite = currentSprite();
+        int count = sprite.parts.count();
+
+        updating = true;
+        partCountLabel->setText(tr("%1").arg(count));
+        currentPartSpinBox->setRange(0, qMax(count - 1, 0));
+        removePartButton->setEnabled(count != 0);
+
+        if(count)
+        {
+            const auto& part = sprite.parts[currentPartSpinBox->value()];
+            partXSpinBox->setValue(part.x);
+            partYSpinBox->setValue(part.y);
+            partTileSpinBox->setValue(tall ? Part::tallPair(part.tile) : part.tile);
+            partPaletteSpinBox->setValue(part.palette());
+            horizontalFlipOption->setChecked(part.attributes & Part::HorizontalFlip);
+            verticalFlipOption->setChecked(part.attributes & Part::VerticalFlip);
+            behindBackgroundOption->setChecked(part.attributes & Part::BehindBackground);
+        }
+        updating = false;
+    }
+
+    void EditorWidget::updateSceneFields()
+    {
+        QStringList names;
+        foreach(const Placement& placement, scene)
+        {
+            names.append(tr("%1 frame %2 at Y %3").arg(animations[placement.animation].name).arg(placement.frame).arg(placement.y));
+        }
+        if(names.isEmpty())
+        {
+            sceneLabel->setText(tr("Scene: only the current frame."));
+        }
+        else
+        {
+            sceneLabel->setText(tr("Scene: the current frame, %1.").arg(names.join(tr(", "))));
+        }
+        clearSceneButton->setEnabled(!scene.isEmpty());
+    }
+
+    void EditorWidget::partsMoved()
+    {
+        // The scene may show the frame being edited too, and those copies can't be adjusted in place.
+        foreach(const Placement& placement, scene)
+        {
+            if(placement.animation == currentAnimation && placement.frame == currentFrame)
+            {
+                rebuildScanlines();
+                return;
+            }
+        }
+        updateScanlines();
+    }
+
+    void EditorWidget::rebuildScanlines()
+    {
+        scanlines.clear();
+        scanlines.addMetasprite(currentSprite(), originY());
+        foreach(const Placement& placement, scene)
+        {
+            scanlines.addMetasprite(animations[placement.animation].frames[placement.frame], placement.y);
+        }
+        updateScanlines();
+    }
+
+    void EditorWidget::updateScanlines()
+    {
+        if(scanlines.overflowLines())
+        {
+            overflowLabel->setText(tr("<b>%1 line(s) over the %2 sprite limit:</b> %3")
+                .arg(scanlines.overflowLines())
+                .arg(ScanlineAnalyzer::SpritesPerLine)
+                .arg(scanlines.overflowRanges())
+            );
+        }
+        else
+        {
+            overflowLabel->setText(tr("No overflow. Busiest line has %1 sprite(s).").arg(scanlines.peakCount()));
+        }
+
+        // The current frame's parts come first in OAM, then each scene placement's in order.
+        const auto& sprite = currentSprite();
+        QVector<int> spriteY;
+        foreach(const Part& part, sprite.parts)
+        {
+            spriteY.append(originY() + part.y);
+        }
+        foreach(const Placement& placement, scene)
+        {
+            foreach(const Part& part, animations[placement.animation].frames[placement.frame].parts)
+            {
+                spriteY.append(placement.y + part.y);
+            }
+        }
+
+        auto strategy = ScanlineAnalyzer::Strategy(flickerStrategyBox->itemData(flickerStrategyBox->currentIndex()).toInt());
+        auto result = ScanlineAnalyzer::simulateFlicker(spriteY, scanlines.spriteHeight(), strategy, FLICKER_FRAMES);
+        if(result.droppedFrames)
+        {
+            int worstPart = 0;
+            for(int i = 1, end = spriteY.count(); i != end; ++i)
+            {
+                if(result.visibleFrames[i] < result.visibleFrames[worstPart])
+                {
+                    worstPart = i;
+                }
+            }
+
+            auto worstName = tr("Part %1").arg(worstPart);
+            int first = sprite.parts.count();
+            foreach(const Placement& placement, scene)
+            {
+                int count = animations[placement.animation].frames[placement.frame].parts.count();
+                if(worstPart >= first && worstPart < first + count)
+                {
+                    worstName = tr("Part %1 of %2 frame %3").arg(worstPart - first).arg(animations[placement.animation].name).arg(placement.frame);
+                    break;
+                }
+                first += count;
+            }
+            flickerLabel->setText(tr("Parts dropped in %1 of %2 frames. %3 is worst: visible %4 frame(s), hidden up to %5 in a row.")
+                .arg(result.droppedFrames)
+                .arg(result.frames)
+                .arg(worstName)
+                .arg(result.visibleFrames[worstPart])
+                .arg(result.longestHidden[worstPart])
+            );
+        }
+        else
+        {
+            flickerLabel->setText(tr("Every part is visible in all %1 frames.").arg(result.frames));
+        }
+    }
+
+    void EditorWidget::updatePreview()
+    {
+        const auto& animation = animations[currentAnimation];
+        const auto& sprite = currentSprite();
+        int height = spriteHeight();
+        if(sprite.parts.isEmpty())
+        {
+            previewLabel->setText(tr("No parts to preview."));
+            return;
+        }
+
+        QRect bounds;
+        foreach(const Part& part, sprite.parts)
+        {
+            bounds |= QRect(part.x, part.y, TILE_WIDTH, height);
+        }
+
+        QImage canvas(bounds.size(), QImage::Format_RGB32);
+        canvas.fill(getPaletteColor(0));
+
+        // Earlier parts have priority, so they're drawn last.
+        int cellTiles = height / TILE_HEIGHT;
+        for(int p = sprite.parts.count() - 1; p >= 0; --p)
+        {
+            const auto& part = sprite.parts[p];
+            int top = tall ? Part::tallPair(part.tile) * 2 : animation.chrTile(part.tile);
+            int flips = (part.attributes & Part::HorizontalFlip ? TileStore::HorizontalFlip : 0)
+                | (part.attributes & Part::VerticalFlip ? TileStore::VerticalFlip : 0);
+
+            QRgb colors[4];
+            for(int i = 0; i != 4; ++i)
+            {
+                colors[i] = palettes.isUsed(part.palette()) ? palettes.color(part.palette(), i) : getPaletteColor(i);
+            }
+
+            // A vertically flipped pair also swaps which tile is on top.
+            for(int t = 0; t != cellTiles; ++t)
+            {
+                int tile = top + (flips & TileStore::VerticalFlip ? cellTiles - 1 - t : t);
+                chr.renderTile(tile, flips, colors, &canvas, part.x - bounds.left(), part.y - bounds.top() + t * TILE_HEIGHT, true);
+            }
+        }
+
+        previewLabel->setPixmap(QPixmap::fromImage(canvas.scaled(canvas.size() * 2)));
+    }
 }
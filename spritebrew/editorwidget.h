@@ -2,33 +2,148 @@
 #define EDITORWIDGET_H
 
 #include <QtGui>
+#include "assetcache.h"
+#include "tilestore.h"
+#include "metasprite.h"
+#include "palette.h"
+#include "scanlineanalyzer.h"
+#include "sharedchr.h"
 
 namespace spritebrew
 {
+    using overbrew::AssetCache;
+    using overbrew::SharedCHR;
+    using overbrew::TileStore;
+
+    class SpriteTableModel;
+    class SpriteTableView;
+
     class EditorWidget : public QWidget
     {
         Q_OBJECT
         private:
+            // Another animation frame drawn alongside the one being edited, for scanline checks.
+            struct Placement
+            {
+                int animation;
+                int frame;
+                int y;
+            };
+
             static const int TILE_WIDTH = 8;
             static const int TILE_HEIGHT = 8;
+            static const int ORIGIN_Y = 128;
+            static const int FLICKER_FRAMES = 60;
 
         public:
             EditorWidget();
 
         private slots:
             void browse();
+            void animationChanged(int index);
+            void frameChanged(int index);
+            void sliceImage();
+            void exportAnimations();
+            void addPart();
+            void removePart();
+            void currentPartChanged(int index);
+            void partChanged();
+            void tableRowChanged(const QModelIndex& index);
+            void tablePartEdited(int row, int oldY);
+            void flickerStrategyChanged(int index);
+            void originYChanged(int y);
+            void addToScene();
+            void clearScene();
+            void importPalette(int slot);
+            void spriteSizeChanged(int index);
+            void optimizeBanks();
+            void saveCHR();
+            void followChanged(bool checked);
+            void pollShared();
+
         public:
             bool readCHR(const QString& filename);
+            bool writeCHR(const QString& filename);
+            bool writeAnimations(const QString& filename);
+            bool readPalette(int slot, const QString& filename);
 
         private:
+            void renderCHR(bool store = false);
+            void updateCHRViews();
+            QImage chrView(const QVector<QRgb>& colors) const;
             void setupImage(const QString& filename);
             QRgb getPaletteColor(int i);
+            int spriteHeight() const;
+            Metasprite& currentSprite();
+            int originY() const;
+            void setCurrentFrame(int animation, int frame);
+            void updateAnimationFields();
+            void updatePartFields();
+            void partsMoved();
+            void rebuildScanlines();
+            void updateScanlines();
+            void updateSceneFields();
+            void updatePreview();
 
             QPushButton* imageBrowseButton;
             QLabel* imageFilenameLabel;
             QLabel* imageLabel;
+            QLabel* variantsLabel;
+            QComboBox* spriteSizeBox;
+            QComboBox* bankSizeBox;
+            QPushButton* optimizeBanksButton;
+            QPushButton* saveCHRButton;
+            QCheckBox* followOption;
+            QTimer* followTimer;
+
+            QSignalMapper* paletteMapper;
+            QList<QLabel*> paletteLabels;
+            QList<QLabel*> paletteSwatches;
+
+            QComboBox* animationBox;
+            QSpinBox* frameSpinBox;
+            QLabel* frameCountLabel;
+            QPushButton* sliceImageButton;
+            QPushButton* exportAnimationsButton;
+
+            QLabel* partCountLabel;
+            QSpinBox* currentPartSpinBox;
+            QPushButton* addPartButton;
+            QPushButton* removePartButton;
+            QSpinBox* partXSpinBox;
+            QSpinBox* partYSpinBox;
+            QSpinBox* partTileSpinBox;
+            QSpinBox* partPaletteSpinBox;
+            QCheckBox* horizontalFlipOption;
+            QCheckBox* verticalFlipOption;
+            QCheckBox* behindBackgroundOption;
+
+            SpriteTableModel* partModel;
+            SpriteTableView* partTable;
+
+            QSpinBox* originYSpinBox;
+            QPushButton* addToSceneButton;
+            QPushButton* clearSceneButton;
+            QLabel* sceneLabel;
+            QLabel* overflowLabel;
+            QComboBox* flickerStrategyBox;
+            QLabel* flickerLabel;
+            QLabel* previewLabel;
 
-            QImage image;
+            TileStore chr;
+            AssetCache cache;
+            int chrColumns;
+            int chrRows;
+            SharedCHR sharedCHR;
+            quint32 sharedSequence;
+            PaletteStore palettes;
+            QVector<Animation> animations;
+            int currentAnimation;
+            int currentFrame;
+            bool tall;
+            ScanlineAnalyzer scanlines;
+            QVector<Placement> scene;
+            bool updating;
     };
 }
 
@@ -0,0 +1,73 @@
+#ifndef METASPRITE_H
+#define METASPRITE_H
+
+#include <QtGui>
+
+namespace spritebrew
+{
+    // A single hardware sprite, laid out like an OAM entry.
+    struct Part
+    {
+        enum
+        {
+            PaletteMask = 0x07,
+            BehindBackground = 0x20,
+            HorizontalFlip = 0x40,
+            VerticalFlip = 0x80
+        };
+
+        qint8 x;
+        qint8 y;
+        quint8 tile;
+        quint8 attributes;
+
+        Part()
+            : x(0), y(0), tile(0), attributes(0)
+        {
+        }
+
+        int palette() const
+        {
+            return attributes & PaletteMask;
+        }
+
+        // In 8x16 mode, bit 0 of the tile index picks the pattern table and the rest picks an even top tile.
+        static quint8 tallTile(int pair)
+        {
+            int top = pair * 2;
+            return (top & 0xFE) | ((top >> 8) & 0x01);
+        }
+
+        static int tallPair(quint8 tile)
+        {
+            return (((tile & 0x01) << 8) | (tile & 0xFE)) / 2;
+        }
+    };
+
+    struct Metasprite
+    {
+        QVector<Part> parts;
+    };
+
+    struct Animation
+    {
+        QString name;
+        QVector<Metasprite> frames;
+
+        // CHR bank loaded into each sprite pattern window while this animation plays.
+        // Empty when the parts index the character set directly.
+        QVector<int> banks;
+
+        int chrTile(int tile) const
+        {
+            if(banks.isEmpty())
+            {
+                return tile;
+            }
+            int windowTiles = 256 / banks.count();
+            return banks[tile / windowTiles] * windowTiles + tile % windowTiles;
+        }
+    };
+}
+
+#endif
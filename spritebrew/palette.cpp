@@ -0,0 +1,135 @@
+#include <climits>
+
+#include "palette.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace spritebrew
+{
+    quint16 ColorLookup::toRGB15(QRgb color)
+    {
+        return (qRed(color) >> 3) | ((qGreen(color) >> 3) << 5) | ((qBlue(color) >> 3) << 10);
+    }
+
+    QRgb ColorLookup::fromRGB15(quint16 color)
+    {
+        int r = color & 0x1F;
+        int g = (color >> 5) & 0x1F;
+        int b = (color >> 10) & 0x1F;
+        return qRgb((r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2));
+    }
+
+    ColorLookup::ColorLookup()
+    {
+    }
+
+    void ColorLookup::build(const QVector<quint16>& colors, int firstColor)
+    {
+        // Squared distance, weighted toward green like the eye is.
+        table = QByteArray(ENTRIES, '\0');
+        for(int key = 0; key != ENTRIES; ++key)
+        {
+            int r = key & 0x1F;
+            int g = (key >> 5) & 0x1F;
+            int b = (key >> 10) & 0x1F;
+            int best = firstColor;
+            int bestDistance = INT_MAX;
+            for(int i = firstColor, end = colors.count(); i < end; ++i)
+            {
+                int dr = r - (colors[i] & 0x1F);
+                int dg = g - ((colors[i] >> 5) & 0x1F);
+                int db = b - ((colors[i] >> 10) & 0x1F);
+                int distance = 3 * dr * dr + 4 * dg * dg + 2 * db * db;
+                if(distance < bestDistance)
+                {
+                    best = i;
+                    bestDistance = distance;
+                }
+            }
+            table[key] = best;
+        }
+    }
+
+    bool ColorLookup::isEmpty() const
+    {
+        return table.isEmpty();
+    }
+
+    int ColorLookup::lookup(QRgb color) const
+    {
+        return uchar(table[toRGB15(color)]);
+    }
+
+    void ColorLookup::remapScanline(const QRgb* source, uchar* dest, int count) const
+    {
+        // Pixels with less than half alpha map to color 0.
+        auto lut = reinterpret_cast<const uchar*>(table.constData());
+        int i = 0;
+#ifdef __SSE2__
+        const __m128i red = _mm_set1_epi32(0x001F);
+        const __m128i green = _mm_set1_epi32(0x03E0);
+        const __m128i blue = _mm_set1_epi32(0x7C00);
+        for(; i + 4 <= count; i += 4)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            __m128i keys = _mm_or_si128(
+                _mm_and_si128(_mm_srli_epi32(pixels, 19), red),
+                _mm_or_si128(
+                    _mm_and_si128(_mm_srli_epi32(pixels, 6), green),
+                    _mm_and_si128(_mm_slli_epi32(pixels, 7), blue)
+                )
+            );
+            __m128i opaque = _mm_srai_epi32(pixels, 31);
+
+            quint32 k[4];
+            quint32 o[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(k), keys);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o), opaque);
+            dest[i] = lut[k[0]] & o[0];
+            dest[i + 1] = lut[k[1]] & o[1];
+            dest[i + 2] = lut[k[2]] & o[2];
+            dest[i + 3] = lut[k[3]] & o[3];
+        }
+#endif
+        for(; i < count; ++i)
+        {
+            dest[i] = qAlpha(source[i]) & 0x80 ? lut[toRGB15(source[i])] : 0;
+        }
+    }
+
+    PaletteStore::PaletteStore()
+        : palettes(SLOTS), lookups(SLOTS)
+    {
+    }
+
+    bool PaletteStore::isUsed(int slot) const
+    {
+        return !palettes[slot].isEmpty();
+    }
+
+    const QVector<quint16>& PaletteStore::colors(int slot) const
+    {
+        return palettes[slot];
+    }
+
+    QRgb PaletteStore::color(int slot, int index) const
+    {
+        return ColorLookup::fromRGB15(palettes[slot][index]);
+    }
+
+    const ColorLookup& PaletteStore::lookup(int slot) const
+    {
+        return lookups[slot];
+    }
+
+    void PaletteStore::setColors(int slot, const QVector<quint16>& colors)
+    {
+        palettes[slot] = colors;
+        palettes[slot].resize(COLORS);
+
+        // Color 0 is transparent in sprites, so opaque pixels only map to 1 .. 3.
+        lookups[slot].build(palettes[slot], 1);
+    }
+}
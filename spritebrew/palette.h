@@ -0,0 +1,51 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <QtGui>
+
+namespace spritebrew
+{
+    // Maps any 15-bit RGB color to its nearest palette entry with a single table read.
+    class ColorLookup
+    {
+        public:
+            static const int ENTRIES = 32768;
+
+            static quint16 toRGB15(QRgb color);
+            static QRgb fromRGB15(quint16 color);
+
+            ColorLookup();
+
+            void build(const QVector<quint16>& colors, int firstColor);
+            bool isEmpty() const;
+
+            int lookup(QRgb color) const;
+            void remapScanline(const QRgb* source, uchar* dest, int count) const;
+
+        private:
+            QByteArray table;
+    };
+
+    // The eight sprite palette slots, each holding 15-bit RGB colors.
+    class PaletteStore
+    {
+        public:
+            static const int SLOTS = 8;
+            static const int COLORS = 4;
+
+            PaletteStore();
+
+            bool isUsed(int slot) const;
+            const QVector<quint16>& colors(int slot) const;
+            QRgb color(int slot, int index) const;
+            const ColorLookup& lookup(int slot) const;
+
+            void setColors(int slot, const QVector<quint16>& colors);
+
+        private:
+            QVector<QVector<quint16> > palettes;
+            QVector<ColorLookup> lookups;
+    };
+}
+
+#endif
@@ -0,0 +1,259 @@
+#include "scanlineanalyzer.h"
+
+namespace spritebrew
+{
+    ScanlineAnalyzer::ScanlineAnalyzer(int spriteHeight)
+        : height(spriteHeight)
+    {
+        clear();
+    }
+
+    void ScanlineAnalyzer::clear()
+    {
+        counts.fill(0, LineCount);
+        histogram.fill(0, 1);
+        histogram[0] = LineCount;
+        overflow = 0;
+    }
+
+    int ScanlineAnalyzer::spriteHeight() const
+    {
+        return height;
+    }
+
+    void ScanlineAnalyzer::setSpriteHeight(int height)
+    {
+        // Counts can't be resized without knowing the sprites, so start over.
+        this->height = height;
+        clear();
+    }
+
+    void ScanlineAnalyzer::addSprite(int y)
+    {
+        adjust(y, 1);
+    }
+
+    void ScanlineAnalyzer::removeSprite(int y)
+    {
+        adjust(y, -1);
+    }
+
+    void ScanlineAnalyzer::moveSprite(int oldY, int newY)
+    {
+        if(oldY != newY)
+        {
+            adjust(oldY, -1);
+            adjust(newY, 1);
+        }
+    }
+
+    void ScanlineAnalyzer::addMetasprite(const Metasprite& sprite, int y)
+    {
+        foreach(const Part& part, sprite.parts)
+        {
+            adjust(y + part.y, 1);
+        }
+    }
+
+    void ScanlineAnalyzer::removeMetasprite(const Metasprite& sprite, int y)
+    {
+        foreach(const Part& part, sprite.parts)
+        {
+            adjust(y + part.y, -1);
+        }
+    }
+
+    int ScanlineAnalyzer::count(int line) const
+    {
+        return line >= 0 && line < LineCount ? counts[line] : 0;
+    }
+
+    bool ScanlineAnalyzer::isOverflow(int line) const
+    {
+        return count(line) > SpritesPerLine;
+    }
+
+    int ScanlineAnalyzer::overflowLines() const
+    {
+        return overflow;
+    }
+
+    int ScanlineAnalyzer::peakCount() const
+    {
+        for(int i = histogram.count() - 1; i > 0; --i)
+        {
+            if(histogram[i])
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    QString ScanlineAnalyzer::overflowRanges() const
+    {
+        QStringList ranges;
+        int start = -1;
+        int worst = 0;
+        for(int line = 0; line <= LineCount; ++line)
+        {
+            if(line != LineCount && isOverflow(line))
+            {
+                if(start == -1)
+                {
+                    start = line;
+                    worst = 0;
+                }
+                worst = qMax(worst, counts[line]);
+            }
+            else if(start != -1)
+            {
+                if(start == line - 1)
+                {
+                    ranges.append(QString("%1 (%2)").arg(start).arg(worst));
+                }
+                else
+                {
+                    ranges.append(QString("%1-%2 (%3)").arg(start).arg(line - 1).arg(worst));
+                }
+                start = -1;
+            }
+        }
+        return ranges.join(", ");
+    }
+
+    ScanlineAnalyzer::FlickerResult ScanlineAnalyzer::simulateFlicker(const QVector<int>& spriteY, int spriteHeight, Strategy strategy, int frames)
+    {
+        int sprites = spriteY.count();
+
+        FlickerResult result;
+        result.frames = frames;
+        result.visibleFrames.fill(0, sprites);
+        result.longestHidden.fill(0, sprites);
+        result.droppedFrames = 0;
+
+        QVector<int> hiddenRun(sprites, 0);
+        QVector<int> lines(LineCount);
+        for(int frame = 0; frame != frames; ++frame)
+        {
+            // Sprite evaluation takes the first eight sprites in OAM order that land on a line.
+            lines.fill(0);
+            bool dropped = false;
+            foreach(int sprite, spriteOrder(sprites, strategy, frame))
+            {
+                bool visible = true;
+                int top = qMax(spriteY[sprite], 0);
+                int bottom = qMin(spriteY[sprite] + spriteHeight, int(LineCount));
+                for(int line = top; line < bottom; ++line)
+                {
+                    if(lines[line] < SpritesPerLine)
+                    {
+                        ++lines[line];
+                    }
+                    else
+                    {
+                        visible = false;
+                    }
+                }
+
+                if(visible)
+                {
+                    ++result.visibleFrames[sprite];
+                    hiddenRun[sprite] = 0;
+                }
+                else
+                {
+                    dropped = true;
+                    ++hiddenRun[sprite];
+                    result.longestHidden[sprite] = qMax(result.longestHidden[sprite], hiddenRun[sprite]);
+                }
+            }
+            if(dropped)
+            {
+                ++result.droppedFrames;
+            }
+        }
+        return result;
+    }
+
+    void ScanlineAnalyzer::adjust(int y, int delta)
+    {
+        int top = qMax(y, 0);
+        int bottom = qMin(y + height, int(LineCount));
+        for(int line = top; line < bottom; ++line)
+        {
+            int before = counts[line];
+            int after = before + delta;
+            counts[line] = after;
+
+            --histogram[before];
+            if(after >= histogram.count())
+            {
+                histogram.resize(after + 1);
+            }
+            ++histogram[after];
+
+            if(before <= SpritesPerLine && after > SpritesPerLine)
+            {
+                ++overflow;
+            }
+            else if(before > SpritesPerLine && after <= SpritesPerLine)
+            {
+                --overflow;
+            }
+        }
+    }
+
+    QVector<int> ScanlineAnalyzer::spriteOrder(int sprites, Strategy strategy, int frame)
+    {
+        QVector<int> order(sprites);
+        if(sprites == 0)
+        {
+            return order;
+        }
+
+        switch(strategy)
+        {
+            case FixedOrder:
+                for(int i = 0; i != sprites; ++i)
+                {
+                    order[i] = i;
+                }
+                break;
+            case RotateOrder:
+                // Start the OAM fill one sprite later every frame.
+                for(int i = 0; i != sprites; ++i)
+                {
+                    order[i] = (i + frame) % sprites;
+                }
+                break;
+            case ReverseOrder:
+                // Alternate front-to-back and back-to-front.
+                for(int i = 0; i != sprites; ++i)
+                {
+                    order[i] = frame % 2 ? sprites - 1 - i : i;
+                }
+                break;
+            case StrideOrder:
+            {
+                // Step through OAM by a stride coprime to the sprite count, shifting the start each frame.
+                static const int primes[] = { 7, 11, 13, 17, 19, 23, 29, 31 };
+                int stride = 1;
+                for(int p = 0; p != int(sizeof(primes) / sizeof(*primes)); ++p)
+                {
+                    if(sprites % primes[p] != 0)
+                    {
+                        stride = primes[p];
+                        break;
+                    }
+                }
+                for(int i = 0; i != sprites; ++i)
+                {
+                    order[i] = (i * stride + frame) % sprites;
+                }
+                break;
+            }
+        }
+        return order;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SCANLINEANALYZER_H
+#define SCANLINEANALYZER_H
+
+#include <QtGui>
+#include "metasprite.h"
+
+namespace spritebrew
+{
+    // Keeps a running count of hardware sprites on every scanline, so single
+    // part edits only touch the lines that part covers.
+    class ScanlineAnalyzer
+    {
+        public:
+            static const int LineCount = 256;
+            static const int SpritesPerLine = 8;
+
+            enum Strategy
+            {
+                FixedOrder,
+                RotateOrder,
+                ReverseOrder,
+                StrideOrder
+            };
+
+            struct FlickerResult
+            {
+                int frames;
+                QVector<int> visibleFrames;
+                QVector<int> longestHidden;
+                int droppedFrames;
+            };
+
+            explicit ScanlineAnalyzer(int spriteHeight = 8);
+
+            void clear();
+            int spriteHeight() const;
+            void setSpriteHeight(int height);
+
+            void addSprite(int y);
+            void removeSprite(int y);
+            void moveSprite(int oldY, int newY);
+            void addMetasprite(const Metasprite& sprite, int y);
+            void removeMetasprite(const Metasprite& sprite, int y);
+
+            int count(int line) const;
+            bool isOverflow(int line) const;
+            int overflowLines() const;
+            int peakCount() const;
+            QString overflowRanges() const;
+
+            static FlickerResult simulateFlicker(const QVector<int>& spriteY, int spriteHeight, Strategy strategy, int frames);
+
+        private:
+            void adjust(int y, int delta);
+            static QVector<int> spriteOrder(int sprites, Strategy strategy, int frame);
+
+            int height;
+            QVector<int> counts;
+            QVector<int> histogram;
+            int overflow;
+    };
+}
+
+#endif
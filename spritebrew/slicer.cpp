@@ -0,0 +1,236 @@
+#include "slicer.h"
+
+namespace spritebrew
+{
+    namespace
+    {
+        const int SPRITE_WIDTH = 8;
+
+        struct SliceFrame
+        {
+            typedef Slicer::Result result_type;
+
+            SliceFrame(const Slicer* slicer)
+                : slicer(slicer)
+            {
+            }
+
+            result_type operator()(const QImage& frame) const
+            {
+                return slicer->slice(frame);
+            }
+
+            const Slicer* slicer;
+        };
+
+        struct Choice
+        {
+            int total;
+            int peak;
+            int start;
+        };
+    }
+
+    Slicer::Slicer(int spriteHeight)
+        : height(spriteHeight)
+    {
+    }
+
+    Slicer::Result Slicer::slice(const QImage& frame) const
+    {
+        int w = frame.width();
+        int h = frame.height();
+
+        // Opaque pixel counts per column, summed down the rows, so any band can be tested in O(1) per column.
+        QVector<int> prefix((h + 1) * w, 0);
+        QVector<int> nextRow(h + 1, h);
+        for(int y = 0; y != h; ++y)
+        {
+            auto line = frame.constScanLine(y);
+            for(int x = 0; x != w; ++x)
+            {
+                prefix[(y + 1) * w + x] = prefix[y * w + x] + (line[x] ? 1 : 0);
+            }
+        }
+        for(int y = h - 1; y >= 0; --y)
+        {
+            bool opaque = false;
+            for(int x = 0; x != w && !opaque; ++x)
+            {
+                opaque = prefix[(y + 1) * w + x] != prefix[y * w + x];
+            }
+            nextRow[y] = opaque ? y : nextRow[y + 1];
+        }
+
+        // Leftmost-first placement is an optimal cover of the opaque columns in a band.
+        auto bandParts = [&](int start, QVector<int>* positions) -> int
+        {
+            int bottom = qMin(start + height, h);
+            int parts = 0;
+            for(int x = 0; x < w; ++x)
+            {
+                if(prefix[bottom * w + x] != prefix[start * w + x])
+                {
+                    if(positions)
+                    {
+                        positions->append(x);
+                    }
+                    ++parts;
+                    x += SPRITE_WIDTH - 1;
+                }
+            }
+            return parts;
+        };
+
+        // Pick where each band starts, minimizing parts and then the busiest band (scanline usage).
+        QVector<int> costs(h, -1);
+        QVector<Choice> best(h + 1);
+        best[h].total = 0;
+        best[h].peak = 0;
+        best[h].start = -1;
+        for(int y = h - 1; y >= 0; --y)
+        {
+            int r = nextRow[y];
+            if(r == h)
+            {
+                best[y] = best[h];
+                continue;
+            }
+
+            best[y].start = -1;
+            for(int start = r; start >= qMax(y, r - height + 1); --start)
+            {
+                if(costs[start] == -1)
+                {
+                    costs[start] = bandParts(start, 0);
+                }
+                const auto& next = best[qMin(start + height, h)];
+                int total = costs[start] + next.total;
+                int peak = qMax(costs[start], next.peak);
+                if(best[y].start == -1 || total < best[y].total || (total == best[y].total && peak < best[y].peak))
+                {
+                    best[y].total = total;
+                    best[y].peak = peak;
+                    best[y].start = start;
+                }
+            }
+        }
+
+        Result result;
+        result.peak = best[0].peak;
+        for(int y = 0; y < h && best[y].start != -1; y = qMin(best[y].start + height, h))
+        {
+            int start = best[y].start;
+            QVector<int> positions;
+            bandParts(start, &positions);
+            foreach(int x, positions)
+            {
+                Slice slice;
+                slice.x = x;
+                slice.y = start;
+                slice.pixels = QByteArray(SPRITE_WIDTH * height, '\0');
+                for(int j = 0; j != height && start + j < h; ++j)
+                {
+                    auto line = frame.constScanLine(start + j);
+                    for(int i = 0; i != SPRITE_WIDTH && x + i < w; ++i)
+                    {
+                        slice.pixels[j * SPRITE_WIDTH + i] = line[x + i];
+                    }
+                }
+                result.slices.append(slice);
+            }
+        }
+        return result;
+    }
+
+    QList<Slicer::Result> Slicer::sliceAll(const QList<QImage>& frames) const
+    {
+        return QtConcurrent::blockingMapped<QList<Result> >(frames, SliceFrame(this));
+    }
+
+    QImage Slicer::indexed(const QImage& source)
+    {
+        QImage image = source.convertToFormat(QImage::Format_ARGB32);
+        int w = image.width();
+        int h = image.height();
+
+        // Without an alpha channel, the top-left pixel is the background color.
+        bool alpha = source.hasAlphaChannel();
+        QRgb background = w && h ? image.pixel(0, 0) : 0;
+        auto transparent = [&](QRgb color)
+        {
+            return alpha ? qAlpha(color) < 0x80 : color == background;
+        };
+
+        QHash<QRgb, int> shades;
+        for(int y = 0; y != h; ++y)
+        {
+            auto line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            for(int x = 0; x != w; ++x)
+            {
+                if(!transparent(line[x]))
+                {
+                    shades.insert(line[x] | 0xFF000000, 0);
+                }
+            }
+        }
+
+        // Opaque colors become shades 1 .. 3, darkest first.
+        auto colors = shades.keys();
+        qStableSort(colors.begin(), colors.end(),
+            [](QRgb a, QRgb b)
+            {
+                return qGray(a) < qGray(b);
+            }
+        );
+        for(int i = 0, end = colors.count(); i != end; ++i)
+        {
+            shades[colors[i]] = 1 + i * 3 / end;
+        }
+
+        QImage result(w, h, QImage::Format_Indexed8);
+        result.setColorCount(4);
+        for(int y = 0; y != h; ++y)
+        {
+            auto line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            auto dest = result.scanLine(y);
+            for(int x = 0; x != w; ++x)
+            {
+                dest[x] = transparent(line[x]) ? 0 : shades[line[x] | 0xFF000000];
+            }
+        }
+        return result;
+    }
+
+    QImage Slicer::indexed(const QImage& source, const ColorLookup& lookup)
+    {
+        QImage image = source.convertToFormat(QImage::Format_ARGB32);
+        int w = image.width();
+        int h = image.height();
+
+        // Without an alpha channel, the top-left pixel is the background color.
+        if(!source.hasAlphaChannel() && w && h)
+        {
+            QRgb background = image.pixel(0, 0);
+            for(int y = 0; y != h; ++y)
+            {
+                auto line = reinterpret_cast<QRgb*>(image.scanLine(y));
+                for(int x = 0; x != w; ++x)
+                {
+                    if(line[x] == background)
+                    {
+                        line[x] = 0;
+                    }
+                }
+            }
+        }
+
+        QImage result(w, h, QImage::Format_Indexed8);
+        result.setColorCount(4);
+        for(int y = 0; y != h; ++y)
+        {
+            lookup.remapScanline(reinterpret_cast<const QRgb*>(image.constScanLine(y)), result.scanLine(y), w);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef SLICER_H
+#define SLICER_H
+
+#include <QtGui>
+#include "palette.h"
+
+namespace spritebrew
+{
+    // Covers the opaque pixels of a sprite image with as few hardware sprites as possible.
+    class Slicer
+    {
+        public:
+            struct Slice
+            {
+                int x;
+                int y;
+                QByteArray pixels;
+            };
+
+            struct Result
+            {
+                QVector<Slice> slices;
+                int peak;
+            };
+
+            explicit Slicer(int spriteHeight);
+
+            Result slice(const QImage& frame) const;
+            QList<Result> sliceAll(const QList<QImage>& frames) const;
+
+            static QImage indexed(const QImage& source);
+            static QImage indexed(const QImage& source, const ColorLookup& lookup);
+
+        private:
+            int height;
+    };
+}
+
+#endif
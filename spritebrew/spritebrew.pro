@@ -1,5 +1,24 @@
 SOURCES += main.cpp \
     mainwindow.cpp \
-    editorwidget.cpp
+    editorwidget.cpp \
+    animationencoder.cpp \
+    bankoptimizer.cpp \
+    chrtile.cpp \
+    palette.cpp \
+    scanlineanalyzer.cpp \
+    slicer.cpp \
+    spritetablemodel.cpp \
+    spritetableview.cpp
 HEADERS += mainwindow.h \
-    editorwidget.h
+    editorwidget.h \
+    animationencoder.h \
+    bankoptimizer.h \
+    chrtile.h \
+    metasprite.h \
+    palette.h \
+    scanlineanalyzer.h \
+    slicer.h \
+    spritetablemodel.h \
+    spritetableview.h
+
+include(../common/common.pri)
@@ -0,0 +1,152 @@
+#include "spritetablemodel.h"
+
+namespace spritebrew
+{
+    SpriteTableModel::SpriteTableModel(QVector<Animation>* animations, QObject* parent)
+        : QAbstractTableModel(parent), animations(animations), animation(0), frame(0)
+    {
+    }
+
+    void SpriteTableModel::setFrame(int animation, int frame)
+    {
+        beginResetModel();
+        this->animation = animation;
+        this->frame = frame;
+        endResetModel();
+    }
+
+    void SpriteTableModel::reset()
+    {
+        beginResetModel();
+        endResetModel();
+    }
+
+    void SpriteTableModel::insertPart(int row, const Part& part)
+    {
+        beginInsertRows(QModelIndex(), row, row);
+        parts().insert(row, part);
+        endInsertRows();
+    }
+
+    void SpriteTableModel::removePart(int row)
+    {
+        beginRemoveRows(QModelIndex(), row, row);
+        parts().remove(row);
+        endRemoveRows();
+    }
+
+    void SpriteTableModel::setPart(int row, const Part& part)
+    {
+        parts()[row] = part;
+        emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+    }
+
+    bool SpriteTableModel::isFlagColumn(int column)
+    {
+        return column >= HorizontalFlipColumn && column <= BehindBackgroundColumn;
+    }
+
+    int SpriteTableModel::rowCount(const QModelIndex& parent) const
+    {
+        return parent.isValid() ? 0 : parts().count();
+    }
+
+    int SpriteTableModel::columnCount(const QModelIndex& parent) const
+    {
+        return parent.isValid() ? 0 : int(ColumnCount);
+    }
+
+    QVariant SpriteTableModel::data(const QModelIndex& index, int role) const
+    {
+        if(!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+        {
+            return QVariant();
+        }
+
+        const auto& part = parts().at(index.row());
+        switch(index.column())
+        {
+            case XColumn: return int(part.x);
+            case YColumn: return int(part.y);
+            case TileColumn: return int(part.tile);
+            case PaletteColumn: return part.palette();
+            case HorizontalFlipColumn: return bool(part.attributes & Part::HorizontalFlip);
+            case VerticalFlipColumn: return bool(part.attributes & Part::VerticalFlip);
+            case BehindBackgroundColumn: return bool(part.attributes & Part::BehindBackground);
+            default: return QVariant();
+        }
+    }
+
+    QVariant SpriteTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+    {
+        if(role != Qt::DisplayRole)
+        {
+            return QVariant();
+        }
+        if(orientation == Qt::Vertical)
+        {
+            return section;
+        }
+
+        switch(section)
+        {
+            case XColumn: return tr("X");
+            case YColumn: return tr("Y");
+            case TileColumn: return tr("Tile");
+            case PaletteColumn: return tr("Palette");
+            case HorizontalFlipColumn: return tr("H Flip");
+            case VerticalFlipColumn: return tr("V Flip");
+            case BehindBackgroundColumn: return tr("Behind");
+            default: return QVariant();
+        }
+    }
+
+    Qt::ItemFlags SpriteTableModel::flags(const QModelIndex& index) const
+    {
+        if(!index.isValid())
+        {
+            return Qt::NoItemFlags;
+        }
+        if(isFlagColumn(index.column()))
+        {
+            return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+        }
+        return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsEditable;
+    }
+
+    bool SpriteTableModel::setData(const QModelIndex& index, const QVariant& value, int role)
+    {
+        if(!index.isValid() || role != Qt::EditRole)
+        {
+            return false;
+        }
+
+        Part part = parts().at(index.row());
+        int oldY = part.y;
+        switch(index.column())
+        {
+            case XColumn: part.x = qBound(-128, value.toInt(), 127); break;
+            case YColumn: part.y = qBound(-128, value.toInt(), 127); break;
+            case TileColumn: part.tile = qBound(0, value.toInt(), 255); break;
+            case PaletteColumn: part.attributes = (part.attributes & ~Part::PaletteMask) | qBound(0, value.toInt(), int(Part::PaletteMask)); break;
+            case HorizontalFlipColumn: part.attributes = value.toBool() ? part.attributes | Part::HorizontalFlip : part.attributes & ~Part::HorizontalFlip; break;
+            case VerticalFlipColumn: part.attributes = value.toBool() ? part.attributes | Part::VerticalFlip : part.attributes & ~Part::VerticalFlip; break;
+            case BehindBackgroundColumn: part.attributes = value.toBool() ? part.attributes | Part::BehindBackground : part.attributes & ~Part::BehindBackground; break;
+            default: return false;
+        }
+
+        setPart(index.row(), part);
+        emit partEdited(index.row(), oldY);
+        return true;
+    }
+
+    const QVector<Part>& SpriteTableModel::parts() const
+    {
+        return animations->at(animation).frames.at(frame).parts;
+    }
+
+    QVector<Part>& SpriteTableModel::parts()
+    {
+        return (*animations)[animation].frames[frame].parts;
+    }
+}
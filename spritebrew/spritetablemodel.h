@@ -0,0 +1,57 @@
+#ifndef SPRITETABLEMODEL_H
+#define SPRITETABLEMODEL_H
+
+#include <QtGui>
+#include "metasprite.h"
+
+namespace spritebrew
+{
+    // Exposes the parts of one metasprite frame as table rows, reading straight from the animation arrays.
+    class SpriteTableModel : public QAbstractTableModel
+    {
+        Q_OBJECT
+        public:
+            enum Column
+            {
+                XColumn,
+                YColumn,
+                TileColumn,
+                PaletteColumn,
+                HorizontalFlipColumn,
+                VerticalFlipColumn,
+                BehindBackgroundColumn,
+                ColumnCount
+            };
+
+            SpriteTableModel(QVector<Animation>* animations, QObject* parent = 0);
+
+            void setFrame(int animation, int frame);
+            void reset();
+
+            void insertPart(int row, const Part& part);
+            void removePart(int row);
+            void setPart(int row, const Part& part);
+
+            static bool isFlagColumn(int column);
+
+            int rowCount(const QModelIndex& parent = QModelIndex()) const;
+            int columnCount(const QModelIndex& parent = QModelIndex()) const;
+            QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+            QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+            Qt::ItemFlags flags(const QModelIndex& index) const;
+            bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole);
+
+        signals:
+            void partEdited(int row, int oldY);
+
+        private:
+            const QVector<Part>& parts() const;
+            QVector<Part>& parts();
+
+            QVector<Animation>* animations;
+            int animation;
+            int frame;
+    };
+}
+
+#endif
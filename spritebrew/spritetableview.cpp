@@ -0,0 +1,72 @@
+#include "spritetableview.h"
+#include "spritetablemodel.h"
+
+namespace spritebrew
+{
+    SpriteItemDelegate::SpriteItemDelegate(QObject* parent)
+        : QStyledItemDelegate(parent), checkIcon(QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton))
+    {
+    }
+
+    void SpriteItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+    {
+        if(!SpriteTableModel::isFlagColumn(index.column()))
+        {
+            QStyledItemDelegate::paint(painter, option, index);
+            return;
+        }
+
+        QStyleOptionViewItemV4 opt(option);
+        initStyleOption(&opt, index);
+        opt.text = QString();
+        QApplication::style()->drawControl(QStyle::CE_ItemViewItem, &opt, painter, opt.widget);
+
+        if(index.data().toBool())
+        {
+            int size = QApplication::style()->pixelMetric(QStyle::PM_SmallIconSize);
+            QRect rect(0, 0, size, size);
+            rect.moveCenter(option.rect.center());
+            checkIcon.paint(painter, rect, Qt::AlignCenter, option.state & QStyle::State_Enabled ? QIcon::Normal : QIcon::Disabled);
+        }
+    }
+
+    QSize SpriteItemDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+    {
+        if(SpriteTableModel::isFlagColumn(index.column()))
+        {
+            int size = QApplication::style()->pixelMetric(QStyle::PM_SmallIconSize);
+            return QSize(size + 8, size + 4);
+        }
+        return QStyledItemDelegate::sizeHint(option, index);
+    }
+
+    bool SpriteItemDelegate::editorEvent(QEvent* event, QAbstractItemModel* model, const QStyleOptionViewItem& option, const QModelIndex& index)
+    {
+        if(SpriteTableModel::isFlagColumn(index.column()) && event->type() == QEvent::MouseButtonRelease)
+        {
+            auto mouseEvent = static_cast<QMouseEvent*>(event);
+            if(mouseEvent->button() == Qt::LeftButton && option.rect.contains(mouseEvent->pos()))
+            {
+                return model->setData(index, !index.data().toBool(), Qt::EditRole);
+            }
+        }
+        return QStyledItemDelegate::editorEvent(event, model, option, index);
+    }
+
+    SpriteTableView::SpriteTableView(QWidget* parent)
+        : QTableView(parent)
+    {
+        setItemDelegate(new SpriteItemDelegate(this));
+        setSelectionBehavior(QAbstractItemView::SelectRows);
+        setSelectionMode(QAbstractItemView::SingleSelection);
+    }
+
+    QStyleOptionViewItem SpriteTableView::viewOptions() const
+    {
+        QStyleOptionViewItem option = QTableView::viewOptions();
+        option.decorationAlignment = Qt::AlignHCenter | Qt::AlignCenter;
+        option.decorationPosition = QStyleOptionViewItem::Top;
+
+        return option;
+    }
+}
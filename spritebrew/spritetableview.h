@@ -0,0 +1,36 @@
+#ifndef SPRITETABLEVIEW_H
+#define SPRITETABLEVIEW_H
+
+#include <QtGui>
+
+namespace spritebrew
+{
+    // Paints the attribute flags of a sprite table as icons, without any per-cell items.
+    class SpriteItemDelegate : public QStyledItemDelegate
+    {
+        Q_OBJECT
+        public:
+            SpriteItemDelegate(QObject* parent = 0);
+
+            void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+            QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
+
+        protected:
+            bool editorEvent(QEvent* event, QAbstractItemModel* model, const QStyleOptionViewItem& option, const QModelIndex& index);
+
+        private:
+            QIcon checkIcon;
+    };
+
+    class SpriteTableView : public QTableView
+    {
+        Q_OBJECT
+        public:
+            SpriteTableView(QWidget* parent = 0);
+
+        protected:
+            QStyleOptionViewItem viewOptions() const;
+    };
+}
+
+#endif
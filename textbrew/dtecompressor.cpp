@@ -0,0 +1,221 @@
+#include "dtecompressor.h"
+
+namespace textbrew
+{
+    namespace
+    {
+        quint32 pairKey(int a, int b)
+        {
+            return quint32(a) << 16 | quint32(b);
+        }
+    }
+
+    struct DteCompressor::Chunk
+    {
+        const QVector<int>* symbols;
+        int begin;
+        int end;
+    };
+
+    struct DteCompressor::Counts
+    {
+        QHash<quint32, int> counts;
+        QHash<quint32, QVector<int> > positions;
+    };
+
+    struct DteCompressor::CountPairs
+    {
+        typedef Counts result_type;
+
+        result_type operator()(const Chunk& chunk) const
+        {
+            Counts result;
+            const auto& symbols = *chunk.symbols;
+            int last = qMin(chunk.end, symbols.count() - 1);
+            for(int i = chunk.begin; i < last; ++i)
+            {
+                int a = symbols[i];
+                int b = symbols[i + 1];
+                if(a < Barrier && b < Barrier)
+                {
+                    quint32 key = pairKey(a, b);
+                    ++result.counts[key];
+                    result.positions[key].append(i);
+                }
+            }
+            return result;
+        }
+    };
+
+    DteCompressor::DteCompressor(const QVector<int>& symbols, int firstCode, int codeCount, bool nested)
+        : symbols(symbols), firstCode(firstCode), codeCount(codeCount), nested(nested)
+    {
+    }
+
+    DteCompressor::Result DteCompressor::compress() const
+    {
+        Result result;
+        result.firstCode = firstCode;
+        result.pairCount = 0;
+
+        int n = symbols.count();
+        QVector<int> sym(symbols);
+        QVector<int> next(n);
+        QVector<int> prev(n);
+        for(int i = 0; i != n; ++i)
+        {
+            next[i] = i + 1;
+            prev[i] = i - 1;
+        }
+
+        // Count every pair in parallel chunks, merged in order so each position list stays sorted.
+        QList<Chunk> chunks;
+        int chunkCount = qMax(QThread::idealThreadCount(), 1) * 4;
+        int chunkSize = qMax((n + chunkCount - 1) / chunkCount, 1);
+        for(int begin = 0; begin < n; begin += chunkSize)
+        {
+            Chunk chunk = { &sym, begin, qMin(begin + chunkSize, n) };
+            chunks.append(chunk);
+        }
+
+        QHash<quint32, int> counts;
+        QHash<quint32, QVector<int> > positions;
+        foreach(const Counts& partial, QtConcurrent::blockingMapped<QList<Counts> >(chunks, CountPairs()))
+        {
+            for(auto it = partial.counts.constBegin(); it != partial.counts.constEnd(); ++it)
+            {
+                counts[it.key()] += it.value();
+                positions[it.key()] += partial.positions[it.key()];
+            }
+        }
+
+        auto isPairCode = [&](int symbol)
+        {
+            return symbol >= firstCode && symbol < firstCode + result.pairCount;
+        };
+        auto pairable = [&](int a, int b)
+        {
+            return a < Barrier && b < Barrier && (nested || (!isPairCode(a) && !isPairCode(b)));
+        };
+        auto subtract = [&](int a, int b)
+        {
+            if(pairable(a, b))
+            {
+                auto it = counts.find(pairKey(a, b));
+                if(it != counts.end() && --it.value() == 0)
+                {
+                    counts.erase(it);
+                }
+            }
+        };
+        auto add = [&](int a, int b, int position)
+        {
+            if(pairable(a, b))
+            {
+                quint32 key = pairKey(a, b);
+                ++counts[key];
+                positions[key].append(position);
+            }
+        };
+
+        while(result.pairCount != codeCount)
+        {
+            // Most frequent pair, lowest key on ties. A pair entry costs two bytes, so it must occur three times to pay off.
+            quint32 best = 0;
+            int bestCount = 0;
+            for(auto it = counts.constBegin(); it != counts.constEnd(); ++it)
+            {
+                if(it.value() > bestCount || (it.value() == bestCount && it.key() < best))
+                {
+                    best = it.key();
+                    bestCount = it.value();
+                }
+            }
+            if(bestCount < 3)
+            {
+                break;
+            }
+
+            int a = best >> 16;
+            int b = best & 0xFFFF;
+            int code = firstCode + result.pairCount;
+            result.pairs.append(char(a));
+            result.pairs.append(char(b));
+            ++result.pairCount;
+
+            // Replace left to right, only touching the counts of the neighbouring pairs.
+            QVector<int> sites(positions.take(best));
+            qSort(sites);
+            foreach(int p, sites)
+            {
+                if(sym[p] != a || next[p] == n || sym[next[p]] != b)
+                {
+                    continue;
+                }
+                int q = next[p];
+                int before = prev[p];
+                int after = next[q];
+
+                subtract(a, b);
+                if(before != -1)
+                {
+                    subtract(sym[before], a);
+                }
+                if(after != n)
+                {
+                    subtract(b, sym[after]);
+                }
+
+                sym[p] = code;
+                sym[q] = -1;
+                next[p] = after;
+                if(after != n)
+                {
+                    prev[after] = p;
+                }
+
+                if(before != -1)
+                {
+                    add(sym[before], code, before);
+                }
+                if(after != n)
+                {
+                    add(code, sym[after], p);
+                }
+            }
+            counts.remove(best);
+        }
+
+        for(int i = 0; i != n; i = next[i])
+        {
+            result.text.append(char(sym[i] & 0xFF));
+        }
+        return result;
+    }
+
+    QByteArray DteCompressor::expand(const QByteArray& text, const QByteArray& pairs, int firstCode)
+    {
+        QByteArray result;
+        QVector<int> stack;
+        for(int i = text.size() - 1; i >= 0; --i)
+        {
+            stack.append(uchar(text[i]));
+        }
+        while(!stack.isEmpty())
+        {
+            int code = stack.last();
+            stack.pop_back();
+            int pair = code - firstCode;
+            if(pair >= 0 && pair * 2 < pairs.size())
+            {
+                stack.append(uchar(pairs[pair * 2 + 1]));
+                stack.append(uchar(pairs[pair * 2]));
+            }
+            else
+            {
+                result.append(char(code));
+            }
+        }
+        return result;
+    }
+}
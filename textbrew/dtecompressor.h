@@ -0,0 +1,43 @@
+#ifndef DTECOMPRESSOR_H
+#define DTECOMPRESSOR_H
+
+#include <QtGui>
+
+namespace textbrew
+{
+    // Dual tile encoding: repeatedly replaces the most frequent adjacent pair of codes with an unused code.
+    // With nesting, pairs may contain earlier pairs, which turns the pair table into a dictionary.
+    class DteCompressor
+    {
+        public:
+            // Flags a symbol that must never be paired, like an end code or part of a multi-byte code.
+            static const int Barrier = 0x100;
+
+            struct Result
+            {
+                QByteArray text;
+                QByteArray pairs;
+                int firstCode;
+                int pairCount;
+            };
+
+            DteCompressor(const QVector<int>& symbols, int firstCode, int codeCount, bool nested);
+
+            Result compress() const;
+
+            // Expands pair codes back into the codes they stand for.
+            static QByteArray expand(const QByteArray& text, const QByteArray& pairs, int firstCode);
+
+        private:
+            struct Chunk;
+            struct CountPairs;
+            struct Counts;
+
+            QVector<int> symbols;
+            int firstCode;
+            int codeCount;
+            bool nested;
+    };
+}
+
+#endif
@@ -0,0 +1,391 @@
+#include <QMessageBox>
+
+#include "editorwidget.h"
+#include "atomicfile.h"
+
+namespace textbrew
+{
+    using overbrew::AtomicFile;
+
+    EditorWidget::EditorWidget()
+        : encodedValid(false)
+    {
+        auto mainLayout = new QVBoxLayout();
+        mainLayout->setAlignment(Qt::AlignTop);
+        setLayout(mainLayout);
+
+        if(auto group = new QGroupBox(tr("Sources")))
+        {
+            mainLayout->addWidget(group);
+
+            auto groupLayout = new QGridLayout();
+            groupLayout->setAlignment(Qt::AlignLeft | Qt::AlignTop);
+            group->setLayout(groupLayout);
+
+            tableFilenameLabel = new QLabel(tr("No table yet."));
+            groupLayout->addWidget(new QLabel(tr("Table")), 0, 0);
+            groupLayout->addWidget(tableFilenameLabel, 0, 1);
+            tableBrowseButton = new QPushButton(tr("Import &Table..."));
+            tableBrowseButton->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+            groupLayout->addWidget(tableBrowseButton, 0, 2);
+
+            fontFilenameLabel = new QLabel(tr("No font yet."));
+            groupLayout->addWidget(new QLabel(tr("Font")), 1, 0);
+            groupLayout->addWidget(fontFilenameLabel, 1, 1);
+            fontBrowseButton = new QPushButton(tr("Import &Font..."));
+            fontBrowseButton->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+            groupLayout->addWidget(fontBrowseButton, 1, 2);
+
+            scriptFilenameLabel = new QLabel(tr("No script yet."));
+            groupLayout->addWidget(new QLabel(tr("Script")), 2, 0);
+            groupLayout->addWidget(scriptFilenameLabel, 2, 1);
+            scriptBrowseButton = new QPushButton(tr("Import &Script..."));
+            scriptBrowseButton->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+            groupLayout->addWidget(scriptBrowseButton, 2, 2);
+        }
+        if(auto rowLayout = new QHBoxLayout())
+        {
+            mainLayout->addLayout(rowLayout);
+            if(auto group = new QGroupBox(tr("Info")))
+            {
+                rowLayout->addWidget(group);
+
+                auto groupLayout = new QVBoxLayout();
+                group->setLayout(groupLayout);
+
+                stringsLabel = new QLabel(tr("Strings: 0"));
+                groupLayout->addWidget(stringsLabel);
+
+                rawSizeLabel = new QLabel(tr("Raw Size: 0 byte(s)"));
+                groupLayout->addWidget(rawSizeLabel);
+
+                encodedSizeLabel = new QLabel(tr("Encoded Size: 0 byte(s)"));
+                groupLayout->addWidget(encodedSizeLabel);
+
+                pairsLabel = new QLabel(tr("Pairs: 0"));
+                groupLayout->addWidget(pairsLabel);
+            }
+            if(auto group = new QGroupBox(tr("Compression")))
+            {
+                rowLayout->addWidget(group);
+
+                auto groupLayout = new QVBoxLayout();
+                group->setLayout(groupLayout);
+
+                compressOption = new QCheckBox(tr("Pair Compression (DTE)"));
+                compressOption->setChecked(true);
+                groupLayout->addWidget(compressOption);
+
+                nestedOption = new QCheckBox(tr("Nested Pairs (Dictionary)"));
+                nestedOption->setChecked(false);
+                groupLayout->addWidget(nestedOption);
+            }
+        }
+        if(auto group = new QGroupBox(tr("Preview")))
+        {
+            mainLayout->addWidget(group);
+
+            auto groupLayout = new QVBoxLayout();
+            groupLayout->setAlignment(Qt::AlignCenter | Qt::AlignTop);
+            group->setLayout(groupLayout);
+
+            auto lineLayout = new QHBoxLayout();
+            lineLayout->setAlignment(Qt::AlignLeft);
+            groupLayout->addLayout(lineLayout);
+
+            lineLayout->addWidget(new QLabel(tr("Line")));
+            lineSpinBox = new QSpinBox();
+            lineSpinBox->setRange(1, 1);
+            lineLayout->addWidget(lineSpinBox);
+
+            previewLabel = new QLabel(tr("No preview available."));
+            previewLabel->setAlignment(Qt::AlignCenter);
+            groupLayout->addWidget(previewLabel);
+        }
+
+        connect(tableBrowseButton, SIGNAL(clicked()), this, SLOT(browseTable()));
+        connect(fontBrowseButton, SIGNAL(clicked()), this, SLOT(browseFont()));
+        connect(scriptBrowseButton, SIGNAL(clicked()), this, SLOT(browseScript()));
+        connect(compressOption, SIGNAL(toggled(bool)), this, SLOT(optionsChanged()));
+        connect(nestedOption, SIGNAL(toggled(bool)), this, SLOT(optionsChanged()));
+        connect(lineSpinBox, SIGNAL(valueChanged(int)), this, SLOT(previewLineChanged()));
+    }
+
+    void EditorWidget::browseTable()
+    {
+        auto filename = QFileDialog::getOpenFileName(
+            this,
+            tr("Import Table"),
+            QString(),
+            tr(
+                "Tables (*.tbl)"
+                ";;All Files (*.*)"
+            )
+        );
+        if(!filename.isEmpty())
+        {
+            readTable(filename);
+        }
+    }
+
+    void EditorWidget::browseFont()
+    {
+        auto filename = QFileDialog::getOpenFileName(
+            this,
+            tr("Import Font"),
+            QString(),
+            tr(
+                "Character Sets (*.chr)"
+                ";;All Files (*.*)"
+            )
+        );
+        if(!filename.isEmpty())
+        {
+            readFont(filename);
+        }
+    }
+
+    void EditorWidget::browseScript()
+    {
+        auto filename = QFileDialog::getOpenFileName(
+            this,
+            tr("Import Script"),
+            QString(),
+            tr(
+                "Scripts (*.txt)"
+                ";;All Files (*.*)"
+            )
+        );
+        if(!filename.isEmpty())
+        {
+            readScript(filename);
+        }
+    }
+
+    void EditorWidget::optionsChanged()
+    {
+        nestedOption->setEnabled(compressOption->isChecked());
+        encode();
+    }
+
+    void EditorWidget::previewLineChanged()
+    {
+        updatePreview();
+    }
+
+    bool EditorWidget::readFile(const QString& filename)
+    {
+        auto suffix = QFileInfo(filename).suffix();
+        if(suffix == "tbl")
+        {
+            return readTable(filename);
+        }
+        else if(suffix == "chr")
+        {
+            return readFont(filename);
+        }
+        return readScript(filename);
+    }
+
+    bool EditorWidget::readTable(const QString& filename)
+    {
+        QString error;
+        TextTable result;
+        if(!result.read(filename, &error))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), error);
+            return false;
+        }
+        table = result;
+        tableFilenameLabel->setText(tr("<b>%1</b>").arg(QFileInfo(filename).fileName()));
+        encode();
+        return true;
+    }
+
+    bool EditorWidget::readFont(const QString& filename)
+    {
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' could not be imported as a CHR.").arg(filename));
+            return false;
+        }
+        font = file.read(file.size() / 16 * 16);
+        fontFilenameLabel->setText(tr("<b>%1</b>").arg(QFileInfo(filename).fileName()));
+        updatePreview();
+        return true;
+    }
+
+    bool EditorWidget::readScript(const QString& filename)
+    {
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Import Failed"), tr("'%1' could not be imported as a script.").arg(filename));
+            return false;
+        }
+
+        // Every non-empty line is one string.
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+        lines.clear();
+        while(!stream.atEnd())
+        {
+            QString line(stream.readLine());
+            if(!line.isEmpty())
+            {
+                lines.append(line);
+            }
+        }
+        scriptFilenameLabel->setText(tr("<b>%1</b>").arg(QFileInfo(filename).fileName()));
+        encode();
+        return true;
+    }
+
+    bool EditorWidget::writeText(const QString& filename)
+    {
+        if(!encodedValid)
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), tr("Import a table and a script that it can encode first."));
+            return false;
+        }
+
+        QList<QPair<QString, QByteArray> > files;
+        files.append(qMakePair(filename, encoded.text));
+
+        // The pair table goes alongside: two codes per pair, for pair codes firstCode and up.
+        if(encoded.pairCount)
+        {
+            QFileInfo info(filename);
+            files.append(qMakePair(info.dir().filePath(info.completeBaseName() + ".dte"), encoded.pairs));
+        }
+
+        QString error;
+        if(!AtomicFile::writeFiles(files, &error))
+        {
+            QMessageBox::critical(this->parentWidget(), tr("Save Failed"), error);
+            return false;
+        }
+        return true;
+    }
+
+    bool EditorWidget::encode()
+    {
+        encodedValid = false;
+        if(table.isEmpty() || lines.isEmpty())
+        {
+            return false;
+        }
+
+        // Multi-byte codes and the end code are kept whole by flagging them as barriers.
+        QVector<int> symbols;
+        QVector<QByteArray> codes;
+        lineCodes.clear();
+        for(int i = 0, count = lines.count(); i != count; ++i)
+        {
+            int failedAt;
+            codes.clear();
+            if(!table.encode(lines[i], &codes, &failedAt))
+            {
+                QMessageBox::critical(this->parentWidget(), tr("Encode Failed"),
+                    tr("Line %1, column %2: '%3' isn't in the table.").arg(i + 1).arg(failedAt + 1).arg(lines[i][failedAt]));
+                return false;
+            }
+
+            QByteArray bytes;
+            foreach(const QByteArray& code, codes)
+            {
+                bytes.append(code);
+                foreach(char byte, code)
+                {
+                    symbols.append(uchar(byte) | (code.size() == 1 ? 0 : DteCompressor::Barrier));
+                }
+            }
+            lineCodes.append(bytes);
+            foreach(char byte, table.endCode())
+            {
+                symbols.append(uchar(byte) | DteCompressor::Barrier);
+            }
+        }
+
+        auto range = table.freeRange();
+        DteCompressor compressor(symbols, range.first, compressOption->isChecked() ? range.second : 0, nestedOption->isChecked());
+        encoded = compressor.compress();
+        encodedValid = true;
+
+        stringsLabel->setText(tr("Strings: %1").arg(lines.count()));
+        rawSizeLabel->setText(tr("Raw Size: %1 byte(s)").arg(symbols.count()));
+        encodedSizeLabel->setText(tr("Encoded Size: %1 byte(s)").arg(encoded.text.size() + encoded.pairs.size()));
+        pairsLabel->setText(encoded.pairCount
+            ? tr("Pairs: %1 ($%2 .. $%3)").arg(encoded.pairCount)
+                .arg(encoded.firstCode, 2, 16, QChar('0'))
+                .arg(encoded.firstCode + encoded.pairCount - 1, 2, 16, QChar('0'))
+            : tr("Pairs: 0"));
+
+        lineSpinBox->setRange(1, lines.count());
+        updatePreview();
+        return true;
+    }
+
+    QRgb EditorWidget::getPaletteColor(int i)
+    {
+        switch(i)
+        {
+            case 0: return qRgb(0x50, 0x50, 0x50); break;
+            case 1: return qRgb(0xA0, 0xA0, 0xA0); break;
+            case 2: return qRgb(0xD0, 0xD0, 0xD0); break;
+            case 3: return qRgb(0xFF, 0xFF, 0xFF); break;
+            default: return qRgb(0xFF, 0x00, 0xFF); break;
+        }
+    }
+
+    void EditorWidget::updatePreview()
+    {
+        int line = lineSpinBox->value() - 1;
+        if(font.isEmpty() || line >= lineCodes.count())
+        {
+            return;
+        }
+
+        // Each code is drawn as the font tile with the same index.
+        const auto& codes = lineCodes[line];
+        int tiles = font.size() / 16;
+        int columns = qMin(codes.size(), int(PREVIEW_COLUMNS));
+        int rows = (codes.size() + PREVIEW_COLUMNS - 1) / PREVIEW_COLUMNS;
+        if(columns == 0)
+        {
+            previewLabel->setText(tr("(Empty line.)"));
+            return;
+        }
+
+        QImage image(columns * TILE_WIDTH, rows * TILE_HEIGHT, QImage::Format_Indexed8);
+        image.setColorCount(4);
+        for(int i = 0; i != 4; ++i)
+        {
+            image.setColor(i, getPaletteColor(i));
+        }
+        image.fill(0);
+
+        for(int c = 0, end = codes.size(); c != end; ++c)
+        {
+            int tile = uchar(codes[c]);
+            if(tile >= tiles)
+            {
+                continue;
+            }
+            for(int j = 0; j != TILE_HEIGHT; ++j)
+            {
+                unsigned char low = font[(tile * TILE_HEIGHT + j) * 2];
+                unsigned char high = font[(tile * TILE_HEIGHT + j) * 2 + 1];
+                auto dest = image.scanLine((c / PREVIEW_COLUMNS) * TILE_HEIGHT + j) + (c % PREVIEW_COLUMNS) * TILE_WIDTH;
+                for(int i = 0; i != TILE_WIDTH; ++i)
+                {
+                    dest[i] = ((high & (1 << (7 - i))) ? 2 : 0) | ((low & (1 << (7 - i))) ? 1 : 0);
+                }
+            }
+        }
+
+        previewLabel->setText(tr(""));
+        previewLabel->setPixmap(QPixmap::fromImage(image.scaled(image.width() * 2, image.height() * 2)));
+    }
+}
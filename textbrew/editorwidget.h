@@ -0,0 +1,67 @@
+#ifndef EDITORWIDGET_H
+#define EDITORWIDGET_H
+
+#include <QtGui>
+#include "dtecompressor.h"
+#include "texttable.h"
+
+namespace textbrew
+{
+    class EditorWidget : public QWidget
+    {
+        Q_OBJECT
+        private:
+            static const int TILE_WIDTH = 8;
+            static const int TILE_HEIGHT = 8;
+            static const int PREVIEW_COLUMNS = 32;
+
+        public:
+            EditorWidget();
+
+        private slots:
+            void browseTable();
+            void browseFont();
+            void browseScript();
+            void optionsChanged();
+            void previewLineChanged();
+
+        public:
+            bool readFile(const QString& filename);
+            bool readTable(const QString& filename);
+            bool readFont(const QString& filename);
+            bool readScript(const QString& filename);
+            bool writeText(const QString& filename);
+
+        private:
+            bool encode();
+            void updatePreview();
+            QRgb getPaletteColor(int i);
+
+            QLabel* tableFilenameLabel;
+            QPushButton* tableBrowseButton;
+            QLabel* fontFilenameLabel;
+            QPushButton* fontBrowseButton;
+            QLabel* scriptFilenameLabel;
+            QPushButton* scriptBrowseButton;
+
+            QCheckBox* compressOption;
+            QCheckBox* nestedOption;
+
+            QLabel* stringsLabel;
+            QLabel* rawSizeLabel;
+            QLabel* encodedSizeLabel;
+            QLabel* pairsLabel;
+
+            QSpinBox* lineSpinBox;
+            QLabel* previewLabel;
+
+            TextTable table;
+            QByteArray font;
+            QStringList lines;
+            QVector<QByteArray> lineCodes;
+            DteCompressor::Result encoded;
+            bool encodedValid;
+    };
+}
+
+#endif
@@ -0,0 +1,15 @@
+#include <QApplication>
+#include <QTextEdit>
+
+#include "mainwindow.h"
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    app.setOrganizationName("Overkill");
+    app.setApplicationName(textbrew::AppName);
+
+    textbrew::MainWindow win;
+    win.show();
+    return app.exec();
+}
@@ -0,0 +1,11 @@
+SOURCES += main.cpp \
+    mainwindow.cpp \
+    editorwidget.cpp \
+    dtecompressor.cpp \
+    texttable.cpp
+HEADERS += mainwindow.h \
+    editorwidget.h \
+    dtecompressor.h \
+    texttable.h
+
+include(../common/common.pri)
@@ -0,0 +1,150 @@
+#include "texttable.h"
+
+namespace textbrew
+{
+    TextTable::TextTable()
+        : nodes(1), used(256, false)
+    {
+        nodes[0].mapped = false;
+    }
+
+    bool TextTable::read(const QString& filename, QString* error)
+    {
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            *error = QObject::tr("'%1' could not be opened.").arg(filename);
+            return false;
+        }
+
+        *this = TextTable();
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+        for(int number = 1; !stream.atEnd(); ++number)
+        {
+            // Only the line break is stripped, since "20= " maps a space.
+            QString line(stream.readLine());
+            if(line.isEmpty())
+            {
+                continue;
+            }
+
+            bool terminator = line.startsWith('/');
+            if(terminator)
+            {
+                line.remove(0, 1);
+            }
+
+            int split = line.indexOf('=');
+            QString hex(split == -1 ? line : line.left(split));
+            QByteArray code(QByteArray::fromHex(hex.toLatin1()));
+            if(hex.isEmpty() || hex.size() % 2 || code.size() * 2 != hex.size() || (split == -1 && !terminator))
+            {
+                *error = QObject::tr("Line %1 of '%2' isn't a valid table entry.").arg(number).arg(filename);
+                return false;
+            }
+
+            foreach(char byte, code)
+            {
+                used[uchar(byte)] = true;
+            }
+            if(terminator)
+            {
+                end = code;
+            }
+            if(split != -1 && split + 1 != line.size())
+            {
+                insert(line.mid(split + 1), code);
+            }
+        }
+
+        if(end.isEmpty())
+        {
+            *error = QObject::tr("'%1' has no end code. Mark one with a leading '/', like \"/FF=[END]\".").arg(filename);
+            return false;
+        }
+        return true;
+    }
+
+    bool TextTable::isEmpty() const
+    {
+        return end.isEmpty();
+    }
+
+    QByteArray TextTable::endCode() const
+    {
+        return end;
+    }
+
+    void TextTable::insert(const QString& text, const QByteArray& code)
+    {
+        int node = 0;
+        foreach(QChar c, text)
+        {
+            auto it = nodes[node].children.constFind(c.unicode());
+            if(it == nodes[node].children.constEnd())
+            {
+                Node child;
+                child.mapped = false;
+                nodes.append(child);
+                it = nodes[node].children.insert(c.unicode(), nodes.count() - 1);
+            }
+            node = it.value();
+        }
+        nodes[node].code = code;
+        nodes[node].mapped = true;
+    }
+
+    bool TextTable::encode(const QString& text, QVector<QByteArray>* codes, int* failedAt) const
+    {
+        auto data = text.constData();
+        for(int i = 0, size = text.size(); i != size;)
+        {
+            int node = 0;
+            int match = -1;
+            int length = 0;
+            for(int j = i; j != size; ++j)
+            {
+                auto it = nodes[node].children.constFind(data[j].unicode());
+                if(it == nodes[node].children.constEnd())
+                {
+                    break;
+                }
+                node = it.value();
+                if(nodes[node].mapped)
+                {
+                    match = node;
+                    length = j - i + 1;
+                }
+            }
+
+            if(match == -1)
+            {
+                *failedAt = i;
+                return false;
+            }
+            codes->append(nodes[match].code);
+            i += length;
+        }
+        return true;
+    }
+
+    QPair<int, int> TextTable::freeRange() const
+    {
+        QPair<int, int> best(0, 0);
+        for(int i = 0; i != 256;)
+        {
+            int count = 0;
+            while(i + count != 256 && !used[i + count])
+            {
+                ++count;
+            }
+            if(count > best.second)
+            {
+                best = qMakePair(i, count);
+            }
+            i += count ? count : 1;
+        }
+        return best;
+    }
+}
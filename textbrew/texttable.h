@@ -0,0 +1,41 @@
+#ifndef TEXTTABLE_H
+#define TEXTTABLE_H
+
+#include <QtGui>
+
+namespace textbrew
+{
+    // A .tbl file: lines of "HEX=text" mapping text to tile codes, with "/HEX=text" marking the end-of-string code.
+    class TextTable
+    {
+        public:
+            TextTable();
+
+            bool read(const QString& filename, QString* error);
+            bool isEmpty() const;
+            QByteArray endCode() const;
+
+            // Encodes text longest match first, appending one code per match.
+            // On failure, *failedAt is the offset of the first unmapped character.
+            bool encode(const QString& text, QVector<QByteArray>* codes, int* failedAt) const;
+
+            // The longest run of single byte values that no code uses, as (first, count).
+            QPair<int, int> freeRange() const;
+
+        private:
+            struct Node
+            {
+                QHash<ushort, int> children;
+                QByteArray code;
+                bool mapped;
+            };
+
+            void insert(const QString& text, const QByteArray& code);
+
+            QVector<Node> nodes;
+            QByteArray end;
+            QVector<bool> used;
+    };
+}
+
+#endif